@@ -0,0 +1,42 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <sys/resource.h>
+#include <benchmark/benchmark.h>
+
+namespace bench
+{
+	// Incremented by the global operator new replaced in main.cpp
+	extern std::atomic<size_t> allocations;
+
+	// Measures allocations between its construction and report()
+	class probe
+	{
+	private:
+		size_t start;
+
+	public:
+		probe() : start(allocations.load(std::memory_order_relaxed)) {}
+
+		// bytes is the input size of one iteration, reported as throughput
+		void report(benchmark::State &state, size_t bytes)
+		{
+			const size_t allocs = allocations.load(std::memory_order_relaxed) - this->start;
+			if(bytes != 0)
+				state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+			state.counters["allocs/op"] = benchmark::Counter(
+				static_cast<double>(allocs) / state.iterations());
+
+			struct rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			state.counters["peak_rss_kb"] = benchmark::Counter(static_cast<double>(usage.ru_maxrss));
+		}
+	};
+} // namespace bench
@@ -0,0 +1,54 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "byteorder.hpp"
+
+using namespace boost::network::hashs;
+
+namespace
+{
+	template<typename T>
+	void flip(benchmark::State &state)
+	{
+		std::vector<T> data(state.range(0));
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = static_cast<T>(i * 0x9E3779B97F4A7C15ull);
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			for(T &v : data)
+				v = byteorder::flip(v);
+			benchmark::ClobberMemory();
+		}
+		probe.report(state, data.size() * sizeof(T));
+	}
+
+	template<typename T>
+	void big(benchmark::State &state)
+	{
+		std::vector<T> data(state.range(0));
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = static_cast<T>(i * 0x9E3779B97F4A7C15ull);
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			for(T &v : data)
+				v = byteorder::big(v);
+			benchmark::ClobberMemory();
+		}
+		probe.report(state, data.size() * sizeof(T));
+	}
+} // namespace
+
+BENCHMARK_TEMPLATE(flip, uint16_t)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(flip, uint32_t)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(flip, uint64_t)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(big, uint32_t)->Arg(1 << 20);
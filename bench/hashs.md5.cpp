@@ -0,0 +1,76 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+
+#include "bench.hpp"
+#include "md5.hpp"
+#include "md5_tree.hpp"
+#include "md5_chunker.hpp"
+#include "tst/data.hpp"
+
+using namespace boost::network::hashs;
+
+namespace
+{
+	void md5_buffer(benchmark::State &state)
+	{
+		const std::string data = tst::data(state.range(0));
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			md5 h;
+			h.update(data.data(), data.size());
+			benchmark::DoNotOptimize(h.finish());
+		}
+		probe.report(state, data.size());
+	}
+
+	void md5_stream(benchmark::State &state)
+	{
+		const std::string data = tst::data(state.range(0));
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::istringstream is(data);
+			benchmark::DoNotOptimize(md5(is).hash());
+		}
+		probe.report(state, data.size());
+	}
+
+	void md5_tree_buffer(benchmark::State &state)
+	{
+		const std::string data = tst::data(state.range(0));
+		const md5_tree tree;
+
+		bench::probe probe;
+		for(auto _ : state)
+			benchmark::DoNotOptimize(tree.hash(data.data(), data.size()));
+		probe.report(state, data.size());
+	}
+
+	void md5_chunker_stream(benchmark::State &state)
+	{
+		const std::string data = tst::data(state.range(0));
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::istringstream is(data);
+			md5_chunker chunker(is);
+			md5_chunker::chunk c;
+			while(chunker.next(c))
+				benchmark::DoNotOptimize(c);
+		}
+		probe.report(state, data.size());
+	}
+} // namespace
+
+BENCHMARK(md5_buffer)->RangeMultiplier(16)->Range(64, 1 << 30);
+BENCHMARK(md5_stream)->RangeMultiplier(16)->Range(64, 64 << 20);
+BENCHMARK(md5_tree_buffer)->Arg(256 << 20)->UseRealTime();
+BENCHMARK(md5_chunker_stream)->Arg(64 << 20);
@@ -0,0 +1,399 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <fstream>
+#include <sstream>
+
+#include "bench.hpp"
+#include "json.hpp"
+#include "json_writer.hpp"
+#include "json_document.hpp"
+#include "json_schema.hpp"
+#include "json_columns.hpp"
+#include "json_filter.hpp"
+#include "decompress.hpp"
+
+namespace
+{
+	enum corpus
+	{
+		SAMPLE,
+		LARGE,
+		DEEP,
+		NUMBERS,
+		STRINGS,
+	};
+
+	std::string generate(corpus c)
+	{
+		std::stringstream ss;
+		switch(c)
+		{
+		case SAMPLE:
+		{
+			std::ifstream sample("tst/sample.json");
+			ss << sample.rdbuf();
+			break;
+		}
+		case LARGE:
+			ss << "[";
+			for(int i = 0; i < 20000; i++)
+			{
+				ss << (i ? "," : "") << "{\"id\":" << i << ",\"name\":\"user" << i << "\",\"active\":" << (i % 2 ? "true" : "false")
+					<< ",\"score\":" << i * 0.25 << ",\"tags\":[\"a\",\"b\",\"c\"],\"address\":{\"city\":\"Paris\",\"zip\":\"75001\"}}";
+			}
+			ss << "]";
+			break;
+		case DEEP:
+			ss << "[";
+			for(int i = 0; i < 500; i++)
+				ss << "{\"next\":[" << i << ",";
+			ss << "null";
+			for(int i = 0; i < 500; i++)
+				ss << "]}";
+			ss << "]";
+			break;
+		case NUMBERS:
+			ss << "[";
+			for(int i = 0; i < 100000; i++)
+				ss << (i ? "," : "") << (i % 2 ? i * 7919 : i) << "," << -i * 1.000123;
+			ss << "]";
+			break;
+		case STRINGS:
+			ss << "[";
+			for(int i = 0; i < 20000; i++)
+				ss << (i ? "," : "") << "\"Lorem ipsum dolor sit amet, \\\"quoted\\\" \\t tab \\u00e9\\u2018 caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac " << i << "\"";
+			ss << "]";
+			break;
+		}
+		return ss.str();
+	}
+
+	const std::string& input(corpus c)
+	{
+		static std::string corpora[5];
+		if(corpora[c].empty())
+			corpora[c] = generate(c);
+		return corpora[c];
+	}
+
+	void parse(benchmark::State &state)
+	{
+		const std::string &json = input(static_cast<corpus>(state.range(0)));
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json);
+			json::value v = json::parser(ss).parse();
+			benchmark::DoNotOptimize(v);
+		}
+		probe.report(state, json.size());
+	}
+
+	void parse_reused(benchmark::State &state)
+	{
+		const std::string &json = input(static_cast<corpus>(state.range(0)));
+		json::document doc;
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json);
+			benchmark::DoNotOptimize(doc.parse(ss));
+		}
+		probe.report(state, json.size());
+	}
+
+	// Parsing events only, to compare validation with
+	class skip
+	{
+	public:
+		void begin_object() {}
+		void key(const std::string &) {}
+		void end_object() {}
+		void begin_array() {}
+		void end_array() {}
+		void null() {}
+		void boolean(bool) {}
+		void integer(long long) {}
+		void real(long double) {}
+		void string(const std::string &) {}
+	};
+
+	void parse_events(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+		skip handler;
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json);
+			json::parser(ss).parse(handler);
+		}
+		probe.report(state, json.size());
+	}
+
+	void validate(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+		std::stringstream schema("{\"type\": \"array\", \"items\": {\"type\": \"object\", \"required\": [\"id\", \"name\"],"
+			"\"properties\": {\"id\": {\"type\": \"integer\", \"minimum\": 0}, \"name\": {\"type\": \"string\", \"maxLength\": 32},"
+			"\"active\": {\"type\": \"boolean\"}, \"score\": {\"type\": \"number\"},"
+			"\"tags\": {\"type\": \"array\", \"items\": {\"enum\": [\"a\", \"b\", \"c\"]}},"
+			"\"address\": {\"type\": \"object\", \"required\": [\"city\"], \"properties\": {\"zip\": {\"pattern\": \"^[0-9]+$\"}}}}}}");
+		const json::schema s(json::parser(schema).parse());
+		json::schema::validator v(s);
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json);
+			json::parser(ss).parse(v);
+		}
+		probe.report(state, json.size());
+	}
+
+	std::string gzip(const std::string &input)
+	{
+		z_stream z;
+		std::memset(&z, 0, sizeof(z));
+		deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+		std::string ret(deflateBound(&z, input.size()), '\0');
+		z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+		z.avail_in = input.size();
+		z.next_out = reinterpret_cast<Bytef*>(&ret[0]);
+		z.avail_out = ret.size();
+		deflate(&z, Z_FINISH);
+		ret.resize(z.total_out);
+		deflateEnd(&z);
+		return ret;
+	}
+
+	// 0: inflated in full then parsed, 1: inflated on a thread while parsing
+	void parse_gzip(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+		const std::string compressed = gzip(json);
+		skip handler;
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(compressed);
+			if(state.range(0) == 0)
+			{
+				std::string inflated(json.size(), '\0');
+				uLongf size = inflated.size();
+				z_stream z;
+				std::memset(&z, 0, sizeof(z));
+				inflateInit2(&z, 15 + 16);
+				z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+				z.avail_in = compressed.size();
+				z.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+				z.avail_out = size;
+				inflate(&z, Z_FINISH);
+				inflateEnd(&z);
+				std::stringstream plain(inflated);
+				json::parser(plain).parse(handler);
+			}
+			else
+			{
+				decompress::istream is(ss);
+				json::parser(is).parse(handler);
+			}
+		}
+		probe.report(state, json.size());
+	}
+
+	// Records with a score over 2500, projected on two fields
+	void filter(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+		std::string out;
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json), os;
+			json::writer w(os);
+			json::filter f(w);
+			f.select("id").select("address.city").where("score", json::filter::comparison::GREATER, 2500);
+			f.run(ss);
+			w.flush();
+			out = os.str();
+		}
+		probe.report(state, json.size());
+	}
+
+	void filter_tree(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+		std::string out;
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json), os;
+			json::value v = json::parser(ss).parse();
+			json::writer w(os);
+			w.begin_array();
+			for(json::value &record : v.to_array())
+			{
+				json::value &score = record.get("score");
+				if((score.is_real() ? score.to_real() : score.to_integer()) > 2500)
+				{
+					w.begin_object().key("id").value(record.get("id"));
+					w.key("address").begin_object().key("city").value(record.get("address").get("city")).end_object();
+					w.end_object();
+				}
+			}
+			w.end_array().flush();
+			out = os.str();
+		}
+		probe.report(state, json.size());
+	}
+
+	void columns_extract(benchmark::State &state)
+	{
+		const std::string &json = input(LARGE);
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::stringstream ss(json);
+			benchmark::DoNotOptimize(json::extract_columns(ss, {"id", "score"}));
+		}
+		probe.report(state, json.size());
+	}
+
+	// Scan of a column, against the same sum over a parsed tree
+	void columns_scan(benchmark::State &state)
+	{
+		std::stringstream ss(input(LARGE));
+		const json::columns cols = json::extract_columns(ss);
+		const json::column &score = cols.get("score");
+
+		bench::probe probe;
+		for(auto _ : state)
+			benchmark::DoNotOptimize(score.sum_reals());
+		probe.report(state, score.reals.size() * sizeof(double));
+	}
+
+	void tree_scan(benchmark::State &state)
+	{
+		std::stringstream ss(input(LARGE));
+		json::value v = json::parser(ss).parse();
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			double sum = 0;
+			for(json::value &record : v.to_array())
+			{
+				json::value &score = record.get("score");
+				sum += score.is_real() ? static_cast<double>(score.to_real()) : score.to_integer();
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		probe.report(state, v.size() * sizeof(double));
+	}
+
+	void write(benchmark::State &state)
+	{
+		const std::string &json = input(static_cast<corpus>(state.range(0)));
+		std::stringstream in(json);
+		json::value v = json::parser(in).parse();
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::ostringstream out;
+			json::writer(out).value(v);
+			benchmark::DoNotOptimize(out);
+		}
+		probe.report(state, json.size());
+	}
+
+	void serialize(benchmark::State &state)
+	{
+		const std::string &json = input(static_cast<corpus>(state.range(0)));
+		std::stringstream in(json);
+		json::value v = json::parser(in).parse();
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			std::ostringstream out;
+			out << v;
+			benchmark::DoNotOptimize(out);
+		}
+		probe.report(state, json.size());
+	}
+
+	void lookup(benchmark::State &state)
+	{
+		std::stringstream in(input(LARGE));
+		json::value v = json::parser(in).parse();
+		const std::string name("name"), city("city");
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			for(json::value &record : v.to_array())
+			{
+				benchmark::DoNotOptimize(record.get(name));
+				benchmark::DoNotOptimize(record.get("address").get(city));
+			}
+		}
+		probe.report(state, 0);
+		state.SetItemsProcessed(state.iterations() * v.size() * 2);
+	}
+
+	void lookup_interned(benchmark::State &state)
+	{
+		std::stringstream in(input(LARGE));
+		json::key_table keys;
+		json::value v = json::parser(in, keys).parse();
+		const json::key name = keys.intern("name"), address = keys.intern("address"), city = keys.intern("city");
+
+		bench::probe probe;
+		for(auto _ : state)
+		{
+			for(json::value &record : v.to_array())
+			{
+				benchmark::DoNotOptimize(record.get(name));
+				benchmark::DoNotOptimize(record.get(address).get(city));
+			}
+		}
+		probe.report(state, 0);
+		state.SetItemsProcessed(state.iterations() * v.size() * 2);
+	}
+
+	void corpora(benchmark::internal::Benchmark *b)
+	{
+		b->ArgName("corpus");
+		for(int c = SAMPLE; c <= STRINGS; c++)
+			b->Arg(c);
+		b->Unit(benchmark::kMillisecond);
+	}
+} // namespace
+
+BENCHMARK(parse)->Apply(corpora);
+BENCHMARK(parse_reused)->Apply(corpora);
+BENCHMARK(serialize)->Apply(corpora);
+BENCHMARK(write)->Apply(corpora);
+BENCHMARK(parse_events)->Unit(benchmark::kMillisecond);
+BENCHMARK(validate)->Unit(benchmark::kMillisecond);
+BENCHMARK(filter)->Unit(benchmark::kMillisecond);
+BENCHMARK(filter_tree)->Unit(benchmark::kMillisecond);
+BENCHMARK(parse_gzip)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(columns_extract)->Unit(benchmark::kMillisecond);
+BENCHMARK(columns_scan);
+BENCHMARK(tree_scan);
+BENCHMARK(lookup)->Unit(benchmark::kMillisecond);
+BENCHMARK(lookup_interned)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,31 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdlib>
+#include <new>
+
+#include "bench.hpp"
+
+std::atomic<size_t> bench::allocations(0);
+
+void* operator new(size_t size)
+{
+	bench::allocations.fetch_add(1, std::memory_order_relaxed);
+	if(void *ret = std::malloc(size ? size : 1))
+		return ret;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+BENCHMARK_MAIN();
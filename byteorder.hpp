@@ -35,7 +35,7 @@ namespace byteorder
 		uint32_t lo = static_cast<uint32_t>(i);
 		uint32_t hi = static_cast<uint32_t>(i >> 32);
 		
-		return (static_cast<uint64_t>(hi) << 32) | lo;
+		return (static_cast<uint64_t>(flip(lo)) << 32) | flip(hi);
 	}
 
 	
@@ -0,0 +1,380 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
+#include <istream>
+#include <streambuf>
+#include <exception>
+#include <stdexcept>
+#include <condition_variable>
+
+#include <zlib.h>
+#ifdef VITRINE_ZSTD
+	#include <zstd.h>
+#endif
+
+// Decompressed input for json::parser and md5: a std::istream over a gzip,
+// zlib or zstd stream, decompressed on a thread of its own into a ring of a
+// few buffers, so decompression overlaps with whatever reads it and memory
+// stays bounded. zstd needs -DVITRINE_ZSTD and -lzstd.
+namespace decompress
+{
+	class decompress_error : public std::runtime_error
+	{
+	public:
+		decompress_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	class codec
+	{
+	public:
+		virtual ~codec() {}
+
+		// Decompresses from [in, in_end) to [out, out_end), advancing in and out
+		virtual void run(const char *&in, const char *in_end, char *&out, char *out_end) = 0;
+
+		// True between frames, where the input may end
+		virtual bool idle() const = 0;
+	};
+
+	// Uncompressed input, copied as is
+	class copy_codec : public codec
+	{
+	public:
+		void run(const char *&in, const char *in_end, char *&out, char *out_end)
+		{
+			const size_t size = std::min(in_end - in, out_end - out);
+			std::memcpy(out, in, size);
+			in += size;
+			out += size;
+		}
+
+		bool idle() const
+		{
+			return true;
+		}
+	};
+
+	// gzip or zlib, concatenated gzip members included
+	class zlib_codec : public codec
+	{
+	private:
+		z_stream z;
+		bool between = true;
+
+	public:
+		zlib_codec()
+		{
+			std::memset(&this->z, 0, sizeof(this->z));
+			// 32: detect the gzip or zlib header
+			if(inflateInit2(&this->z, 15 + 32) != Z_OK)
+				throw decompress_error("Can't initialize zlib");
+		}
+
+		zlib_codec(const zlib_codec&) = delete;
+		zlib_codec& operator=(const zlib_codec&) = delete;
+
+		~zlib_codec()
+		{
+			inflateEnd(&this->z);
+		}
+
+		void run(const char *&in, const char *in_end, char *&out, char *out_end)
+		{
+			this->z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+			this->z.avail_in = static_cast<uInt>(in_end - in);
+			this->z.next_out = reinterpret_cast<Bytef*>(out);
+			this->z.avail_out = static_cast<uInt>(out_end - out);
+
+			const int ret = inflate(&this->z, Z_NO_FLUSH);
+			if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+				throw decompress_error(std::string("zlib: ") + (this->z.msg ? this->z.msg : "invalid stream"));
+
+			if(reinterpret_cast<const char*>(this->z.next_in) != in)
+				this->between = false;
+			in = reinterpret_cast<const char*>(this->z.next_in);
+			out = reinterpret_cast<char*>(this->z.next_out);
+
+			if(ret == Z_STREAM_END)
+			{
+				inflateReset(&this->z);
+				this->between = true;
+			}
+		}
+
+		bool idle() const
+		{
+			return this->between;
+		}
+	};
+
+#ifdef VITRINE_ZSTD
+	class zstd_codec : public codec
+	{
+	private:
+		ZSTD_DStream *z;
+		bool between = true;
+
+	public:
+		zstd_codec() : z(ZSTD_createDStream())
+		{
+			if(this->z == nullptr)
+				throw decompress_error("Can't initialize zstd");
+		}
+
+		zstd_codec(const zstd_codec&) = delete;
+		zstd_codec& operator=(const zstd_codec&) = delete;
+
+		~zstd_codec()
+		{
+			ZSTD_freeDStream(this->z);
+		}
+
+		void run(const char *&in, const char *in_end, char *&out, char *out_end)
+		{
+			ZSTD_inBuffer input = {in, static_cast<size_t>(in_end - in), 0};
+			ZSTD_outBuffer output = {out, static_cast<size_t>(out_end - out), 0};
+
+			const size_t ret = ZSTD_decompressStream(this->z, &output, &input);
+			if(ZSTD_isError(ret))
+				throw decompress_error(std::string("zstd: ") + ZSTD_getErrorName(ret));
+
+			in += input.pos;
+			out += output.pos;
+			// 0 once a frame is complete and flushed
+			this->between = ret == 0;
+		}
+
+		bool idle() const
+		{
+			return this->between;
+		}
+	};
+#endif
+
+	// The zlib header is only two bytes, plain input passes for one once in a
+	// while: trial inflate the start of it
+	inline bool inflates(const unsigned char *data, size_t size)
+	{
+		z_stream z;
+		std::memset(&z, 0, sizeof(z));
+		if(inflateInit(&z) != Z_OK)
+			return false;
+
+		unsigned char out[4096];
+		z.next_in = const_cast<Bytef*>(data);
+		z.avail_in = static_cast<uInt>(std::min<size_t>(size, 1024));
+		int ret = Z_OK;
+		while(ret == Z_OK && z.avail_in > 0)
+		{
+			z.next_out = out;
+			z.avail_out = sizeof(out);
+			ret = inflate(&z, Z_NO_FLUSH);
+		}
+		inflateEnd(&z);
+		return ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR;
+	}
+
+	// Picks the codec from the first bytes of the input
+	inline std::unique_ptr<codec> detect(const unsigned char *data, size_t size)
+	{
+		if(size >= 2 && data[0] == 0x1F && data[1] == 0x8B)
+			return std::unique_ptr<codec>(new zlib_codec());
+		// Deflate with a window of at most 32K, no preset dictionary
+		if(size >= 2 && (data[0] & 0x0F) == 8 && (data[0] >> 4) <= 7 && (data[1] & 0x20) == 0
+			&& ((data[0] << 8) | data[1]) % 31 == 0 && inflates(data, size))
+			return std::unique_ptr<codec>(new zlib_codec());
+		if(size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD)
+		{
+#ifdef VITRINE_ZSTD
+			return std::unique_ptr<codec>(new zstd_codec());
+#else
+			throw decompress_error("zstd input, but built without VITRINE_ZSTD");
+#endif
+		}
+		return std::unique_ptr<codec>(new copy_codec());
+	}
+
+	class streambuf : public std::streambuf
+	{
+	private:
+		struct block
+		{
+			std::vector<char> data;
+			size_t size = 0;
+		};
+
+		std::istream &source;
+		std::vector<char> input;
+		const char *in = nullptr, *in_end = nullptr;
+		bool source_done = false;
+		std::unique_ptr<codec> decoder;
+
+		// Blocks [next, next + filled) are decompressed, the first of them
+		// being read while holding is set, the others are the thread's
+		std::vector<block> blocks;
+		size_t next = 0, filled = 0;
+		bool holding = false;
+		bool finished = false, stopping = false;
+		std::exception_ptr error;
+
+		std::mutex lock;
+		std::condition_variable readable, writable;
+		std::thread worker;
+
+		bool refill()
+		{
+			this->source.read(this->input.data(), this->input.size());
+			const size_t got = static_cast<size_t>(this->source.gcount());
+			this->in = this->input.data();
+			this->in_end = this->in + got;
+			return got > 0;
+		}
+
+		// Fills b, false once everything was decompressed
+		bool decompress(block &b)
+		{
+			char *out = b.data.data();
+			char *const out_end = out + b.data.size();
+
+			while(out < out_end)
+			{
+				if(this->in == this->in_end)
+				{
+					if(this->source_done || !this->refill())
+					{
+						this->source_done = true;
+						if(this->decoder && !this->decoder->idle())
+							throw decompress_error("Truncated compressed stream");
+						break;
+					}
+				}
+				if(!this->decoder)
+					this->decoder = detect(reinterpret_cast<const unsigned char*>(this->in), this->in_end - this->in);
+
+				const char *before = this->in;
+				char *written = out;
+				this->decoder->run(this->in, this->in_end, out, out_end);
+
+				// zlib stops on garbage after a member: nothing moves anymore
+				if(this->in == before && out == written && this->in != this->in_end)
+					throw decompress_error("Trailing garbage after compressed stream");
+			}
+
+			b.size = out - b.data.data();
+			return b.size > 0;
+		}
+
+		void run()
+		{
+			try
+			{
+				for(;;)
+				{
+					size_t index;
+					{
+						std::unique_lock<std::mutex> l(this->lock);
+						this->writable.wait(l, [this]() { return this->stopping || this->filled < this->blocks.size(); });
+						if(this->stopping)
+							return;
+						index = (this->next + this->filled) % this->blocks.size();
+					}
+
+					// The block is the thread's until it's counted in filled
+					const bool more = this->decompress(this->blocks[index]);
+
+					std::lock_guard<std::mutex> l(this->lock);
+					if(more)
+						this->filled++;
+					else
+						this->finished = true;
+					this->readable.notify_one();
+					if(!more)
+						return;
+				}
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> l(this->lock);
+				this->error = std::current_exception();
+				this->finished = true;
+				this->readable.notify_one();
+			}
+		}
+
+	protected:
+		int_type underflow()
+		{
+			std::unique_lock<std::mutex> l(this->lock);
+			if(this->holding)
+			{
+				this->next = (this->next + 1) % this->blocks.size();
+				this->filled--;
+				this->holding = false;
+				this->writable.notify_one();
+			}
+
+			this->readable.wait(l, [this]() { return this->filled > 0 || this->finished; });
+			if(this->filled == 0)
+			{
+				if(this->error)
+					std::rethrow_exception(this->error);
+				return traits_type::eof();
+			}
+
+			block &b = this->blocks[this->next];
+			this->holding = true;
+			this->setg(b.data.data(), b.data.data(), b.data.data() + b.size);
+			return traits_type::to_int_type(*this->gptr());
+		}
+
+	public:
+		streambuf(std::istream &_source, size_t block_size = 256 * 1024, size_t count = 4)
+			: source(_source), input(block_size), blocks(std::max<size_t>(count, 2))
+		{
+			for(block &b : this->blocks)
+				b.data.resize(block_size);
+			this->worker = std::thread(&streambuf::run, this);
+		}
+
+		streambuf(const streambuf&) = delete;
+		streambuf& operator=(const streambuf&) = delete;
+
+		// Stops the thread even if the input wasn't read to the end
+		~streambuf()
+		{
+			{
+				std::lock_guard<std::mutex> l(this->lock);
+				this->stopping = true;
+				this->writable.notify_one();
+			}
+			this->worker.join();
+		}
+	};
+
+	// Decompression errors are thrown from the reads, they aren't turned into
+	// a silent end of stream
+	class istream : public std::istream
+	{
+	private:
+		streambuf buf;
+
+	public:
+		istream(std::istream &source, size_t block_size = 256 * 1024, size_t count = 4)
+			: std::istream(nullptr), buf(source, block_size, count)
+		{
+			this->init(&this->buf);
+			this->exceptions(std::ios::badbit);
+		}
+	};
+} // namespace decompress
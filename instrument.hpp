@@ -0,0 +1,202 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+// Parser and md5 counters, only compiled in with -DVITRINE_INSTRUMENT.
+// Every call site goes through VITRINE_INSTRUMENT_ONLY, so nothing is left
+// of them otherwise.
+#ifdef VITRINE_INSTRUMENT
+	#define VITRINE_INSTRUMENT_ONLY(...) __VA_ARGS__
+#else
+	#define VITRINE_INSTRUMENT_ONLY(...)
+#endif
+
+#ifdef VITRINE_INSTRUMENT
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+namespace instrument
+{
+	enum phases
+	{
+		PARSE,		// whole json::parser::parse(), tokenizing is what's left once the others are removed
+		STRINGS,	// string decoding, keys included
+		NUMBERS,	// number conversion
+		HASH,		// md5::hash() over a stream
+		PHASES_COUNT,
+	};
+
+	// Indexed like json::value::types
+	enum { TYPES_COUNT = 8 };
+
+	struct counters
+	{
+		uint64_t parses = 0;
+		uint64_t hashes = 0;
+		uint64_t parsed_bytes = 0;
+		uint64_t hashed_bytes = 0;
+		uint64_t values[TYPES_COUNT] = {};
+		uint64_t strings_escaped = 0;	// strings with at least one escape sequence
+		uint64_t allocations = 0;		// new containers and members, new keys, buffers that had to grow
+		uint64_t max_depth = 0;
+		uint64_t nanoseconds[PHASES_COUNT] = {};
+
+		counters& operator+=(const counters &o)
+		{
+			this->parses += o.parses;
+			this->hashes += o.hashes;
+			this->parsed_bytes += o.parsed_bytes;
+			this->hashed_bytes += o.hashed_bytes;
+			for(size_t i = 0; i < TYPES_COUNT; i++)
+				this->values[i] += o.values[i];
+			this->strings_escaped += o.strings_escaped;
+			this->allocations += o.allocations;
+			if(o.max_depth > this->max_depth)
+				this->max_depth = o.max_depth;
+			for(size_t i = 0; i < PHASES_COUNT; i++)
+				this->nanoseconds[i] += o.nanoseconds[i];
+			return *this;
+		}
+	};
+
+	// Export interface, called on the thread that did the work with the
+	// counters of that single parse or hash.
+	class hook
+	{
+	public:
+		virtual ~hook() {}
+		virtual void parsed(const counters &) {}
+		virtual void hashed(const counters &) {}
+	};
+
+	// Adds its lifetime to a nanoseconds counter
+	class timer
+	{
+	private:
+		uint64_t &target;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		timer(uint64_t &_target) : target(_target), start(std::chrono::steady_clock::now()) {}
+		~timer()
+		{
+			this->target += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - this->start).count();
+		}
+	};
+
+	// Per thread totals. Only the owning thread writes them, readers sum every
+	// slot of the registry, so neither side takes a lock. Slots outlive their
+	// thread and are handed to the next one, keeping totals cumulative.
+	class slot
+	{
+	private:
+		std::atomic<uint64_t> fields[sizeof(counters) / sizeof(uint64_t)];
+
+	public:
+		slot *next = nullptr;
+		std::atomic<bool> used;
+
+		slot() : used(true)
+		{
+			for(auto &f : this->fields)
+				f.store(0, std::memory_order_relaxed);
+		}
+
+		void add(const counters &c)
+		{
+			counters cur = this->load();
+			cur += c;
+
+			const uint64_t *src = reinterpret_cast<const uint64_t*>(&cur);
+			for(size_t i = 0; i < sizeof(counters) / sizeof(uint64_t); i++)
+				this->fields[i].store(src[i], std::memory_order_relaxed);
+		}
+
+		counters load() const
+		{
+			counters ret;
+			uint64_t *dst = reinterpret_cast<uint64_t*>(&ret);
+			for(size_t i = 0; i < sizeof(counters) / sizeof(uint64_t); i++)
+				dst[i] = this->fields[i].load(std::memory_order_relaxed);
+			return ret;
+		}
+	};
+
+	inline std::atomic<slot*>& registry()
+	{
+		static std::atomic<slot*> head(nullptr);
+		return head;
+	}
+
+	inline std::atomic<hook*>& current_hook()
+	{
+		static std::atomic<hook*> ret(nullptr);
+		return ret;
+	}
+
+	inline slot& acquire()
+	{
+		for(slot *s = registry().load(std::memory_order_acquire); s != nullptr; s = s->next)
+		{
+			bool expected = false;
+			if(s->used.compare_exchange_strong(expected, true))
+				return *s;
+		}
+
+		slot *s = new slot();
+		s->next = registry().load(std::memory_order_relaxed);
+		while(!registry().compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed));
+		return *s;
+	}
+
+	class owner
+	{
+	public:
+		slot &s;
+		owner() : s(acquire()) {}
+		~owner() { this->s.used.store(false); }
+	};
+
+	inline slot& local()
+	{
+		static thread_local owner o;
+		return o.s;
+	}
+
+	// The hook must outlive any parser or md5 running while it's installed
+	inline void set_hook(hook *h)
+	{
+		current_hook().store(h);
+	}
+
+	// Totals over every thread since the start of the process
+	inline counters snapshot()
+	{
+		counters ret;
+		for(slot *s = registry().load(std::memory_order_acquire); s != nullptr; s = s->next)
+			ret += s->load();
+		return ret;
+	}
+
+	inline void record_parse(const counters &c)
+	{
+		local().add(c);
+		if(hook *h = current_hook().load(std::memory_order_acquire))
+			h->parsed(c);
+	}
+
+	inline void record_hash(const counters &c)
+	{
+		local().add(c);
+		if(hook *h = current_hook().load(std::memory_order_acquire))
+			h->hashed(c);
+	}
+} // namespace instrument
+
+#endif
@@ -14,21 +14,305 @@
 #include <cassert>
 #include <sstream>
 #include <tuple>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <type_traits>
+#include <functional>
+#include <unordered_set>
+#include <unordered_map>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <clocale>
 
 #include <boost/variant.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/locale.hpp>
+
+#include "md5.hpp"
+#include "instrument.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace json
 {
+	// Numbers are read and written in the C locale whatever the global one,
+	// a decimal comma would make them invalid JSON
+	inline locale_t c_locale()
+	{
+		static const locale_t c = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+		return c;
+	}
+
+	// Switches the calling thread to the C locale for its lifetime
+	class c_locale_scope
+	{
+	private:
+		locale_t previous;
+
+	public:
+		c_locale_scope() : previous(uselocale(c_locale())) {}
+		~c_locale_scope() { uselocale(this->previous); }
+
+		c_locale_scope(const c_locale_scope&) = delete;
+		c_locale_scope& operator=(const c_locale_scope&) = delete;
+	};
+
+	inline void append_utf8(std::string &str, uint32_t cp)
+	{
+		if(cp < 0x80)
+			str += static_cast<char>(cp);
+		else if(cp < 0x800)
+		{
+			str += static_cast<char>(0xC0 | (cp >> 6));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if(cp < 0x10000)
+		{
+			str += static_cast<char>(0xE0 | (cp >> 12));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else
+		{
+			str += static_cast<char>(0xF0 | (cp >> 18));
+			str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+	// Checks str against RFC 3629: no overlong forms, surrogates or code points
+	// past U+10FFFF. ASCII runs are skipped 16 bytes at a time when SSE2 is available.
+	inline bool is_valid_utf8(const char *str, size_t len)
+	{
+		const unsigned char *it = reinterpret_cast<const unsigned char*>(str);
+		const unsigned char *end = it + len;
+
+		while(it != end)
+		{
+#ifdef __SSE2__
+			while(end - it >= 16)
+			{
+				const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+				if(_mm_movemask_epi8(chunk) != 0)
+					break;
+				it += 16;
+			}
+			if(it == end)
+				break;
+#endif
+			const unsigned char c = *it;
+			if(c < 0x80)
+			{
+				it++;
+				continue;
+			}
+
+			size_t count;
+			unsigned char lo = 0x80, hi = 0xBF;
+			if(c >= 0xC2 && c <= 0xDF)
+				count = 1;
+			else if(c >= 0xE0 && c <= 0xEF)
+			{
+				count = 2;
+				if(c == 0xE0)
+					lo = 0xA0;
+				else if(c == 0xED)
+					hi = 0x9F;
+			}
+			else if(c >= 0xF0 && c <= 0xF4)
+			{
+				count = 3;
+				if(c == 0xF0)
+					lo = 0x90;
+				else if(c == 0xF4)
+					hi = 0x8F;
+			}
+			else
+				return false;
+
+			if(static_cast<size_t>(end - it) <= count)
+				return false;
+			if(it[1] < lo || it[1] > hi)
+				return false;
+			for(size_t i = 2; i <= count; i++)
+			{
+				if((it[i] & 0xC0) != 0x80)
+					return false;
+			}
+			it += count + 1;
+		}
+		return true;
+	}
+
 	class value;
-	
-	typedef std::map<std::string, value> object;
+	class hash_cache;
+
+	// Storage shared by equal strings, one copy of each
+	class string_table
+	{
+	public:
+		typedef std::shared_ptr<const std::string> handle;
+
+	private:
+		struct hasher
+		{
+			size_t operator()(const handle &h) const { return std::hash<std::string>()(*h); }
+		};
+
+		struct equal
+		{
+			bool operator()(const handle &a, const handle &b) const { return *a == *b; }
+		};
+
+		std::unordered_set<handle, hasher, equal> strings;
+
+	public:
+		handle intern(const std::string &str)
+		{
+			// Aliasing constructor, points to str without owning nor allocating
+			auto it = this->strings.find(handle(handle(), &str));
+			if(it == this->strings.end())
+				it = this->strings.insert(std::make_shared<const std::string>(str)).first;
+			return *it;
+		}
+
+		size_t size() const	{ return this->strings.size(); }
+		void clear()		{ this->strings.clear(); }
+	};
+
+	// Object key: its own string, or a handle on storage shared by the keys
+	// interned by a key_table. Either one or the other is held, a plain key
+	// is a string and a flag. Keys are ordered and compared as strings,
+	// sharing saves memory, not comparisons.
+	class key
+	{
+	private:
+		typedef std::shared_ptr<const std::string> handle;
+
+		union
+		{
+			std::string own;
+			handle shared;
+		};
+		bool is_shared;
+
+		explicit key(bool) : shared(), is_shared(true) {}
+
+		void destroy()
+		{
+			if(this->is_shared)
+				this->shared.~handle();
+			else
+				this->own.~basic_string();
+		}
+
+		void construct(const key &k)
+		{
+			this->is_shared = k.is_shared;
+			if(k.is_shared)
+				new(&this->shared) handle(k.shared);
+			else
+				new(&this->own) std::string(k.own);
+		}
+
+		void construct(key &&k)
+		{
+			this->is_shared = k.is_shared;
+			if(k.is_shared)
+				new(&this->shared) handle(std::move(k.shared));
+			else
+				new(&this->own) std::string(std::move(k.own));
+		}
+
+	public:
+		key(const char *k)			: own(k), is_shared(false) {}
+		key(const std::string &k)	: own(k), is_shared(false) {}
+		key(std::string &&k)		: own(std::move(k)), is_shared(false) {}
+		explicit key(const handle &k) : shared(k), is_shared(true) {}
+
+		key(const key &k)	{ this->construct(k); }
+		key(key &&k)		{ this->construct(std::move(k)); }
+		~key()				{ this->destroy(); }
+
+		key& operator=(const key &k)
+		{
+			if(this != &k)
+			{
+				this->destroy();
+				this->construct(k);
+			}
+			return *this;
+		}
+
+		key& operator=(key &&k)
+		{
+			if(this != &k)
+			{
+				this->destroy();
+				this->construct(std::move(k));
+			}
+			return *this;
+		}
+
+		// Non-owning key, only valid for lookups while k is alive
+		static key ref(const std::string &k)
+		{
+			// Aliasing constructor, points to k without owning nor allocating
+			key ret(true);
+			ret.shared = handle(handle(), &k);
+			return ret;
+		}
+
+		const std::string& to_string() const	{ return this->is_shared ? *this->shared : this->own; }
+		operator const std::string&() const		{ return this->to_string(); }
+
+		// True if the storage is shared, e.g. interned by a key_table
+		bool interned() const					{ return this->is_shared; }
+
+		// True if both keys share the same storage, e.g. interned by the same key_table
+		bool same(const key &k) const			{ return &this->to_string() == &k.to_string(); }
+
+		bool operator==(const key &k) const		{ return this->same(k) || this->to_string() == k.to_string(); }
+		bool operator!=(const key &k) const		{ return !(*this == k); }
+		bool operator<(const key &k) const		{ return this->to_string() < k.to_string(); }
+	};
+
+	inline std::ostream& operator<<(std::ostream &o, const key &k)
+	{
+		return o << k.to_string();
+	}
+
+	class key_table
+	{
+	private:
+		string_table strings;
+
+	public:
+		// Keys short enough for std::string's own buffer stay plain, sharing
+		// them would take more room than it saves
+		key intern(const std::string &k)
+		{
+			if(k.size() <= std::string().capacity())
+				return key(k);
+			return key(this->strings.intern(k));
+		}
+
+		size_t size() const	{ return this->strings.size(); }
+		void clear()		{ this->strings.clear(); }
+	};
+
+	typedef std::map<key, value> object;
 	typedef std::vector<value> array;
 	typedef boost::variant<
 		long long,
 		long double,
 		std::string,
+		string_table::handle,
 		boost::recursive_wrapper<array>,
 		boost::recursive_wrapper<object>
 		> __variant;
@@ -36,6 +320,8 @@ namespace json
 	class value
 	{
 	public:
+		typedef boost::network::hashs::md5::digest digest;
+
 		enum class types
 		{
 			NONE,
@@ -47,8 +333,33 @@ namespace json
 			BOOLEAN,
 			NILL,
 		} type;
-		
+
+	private:
+		// Renewed when a container is handed out for writing, see hash_cache.
+		// Kept by copies, whose content is the same, cleared by moves.
+		uint64_t stamp = 0;
+
+	public:
 		__variant variant;
+
+	private:
+		// Parses into existing values, reusing their storage
+		friend class parser;
+		friend class hash_cache;
+
+		// Unique over every thread, the thread's number in the high bits
+		static uint64_t next_stamp()
+		{
+			static std::atomic<uint64_t> threads(0);
+			static thread_local uint64_t base = (threads.fetch_add(1, std::memory_order_relaxed) + 1) << 40;
+			static thread_local uint64_t count = 0;
+			return base | ++count;
+		}
+
+		void touch()
+		{
+			this->stamp = next_stamp();
+		}
 	
 	public:
 		value()							: type(types::NILL),	variant(static_cast<long long>(0)) {}
@@ -59,11 +370,31 @@ namespace json
 		value(long double val)			: type(types::REAL),	variant(static_cast<long double>(val)) {}
 		value(const char *val)			: type(types::STRING),	variant(std::string(val)) {}
 		value(const std::string &val)	: type(types::STRING),	variant(val) {}
-		value(const std::string &&val)	: type(types::STRING),	variant(val) {}
-		value(const array &val)			: type(types::ARRAY),	variant(val) {}
-		value(const array &&val)		: type(types::ARRAY),	variant(val) {}
-		value(const object &val)		: type(types::OBJECT),	variant(val) {}
-		value(const object &&val)		: type(types::OBJECT),	variant(val) {}
+		value(std::string &&val)		: type(types::STRING),	variant(std::move(val)) {}
+		explicit value(const string_table::handle &val) : type(types::STRING), variant(val) {}
+		value(const array &val)			: type(types::ARRAY),	stamp(next_stamp()), variant(val) {}
+		value(array &&val)				: type(types::ARRAY),	stamp(next_stamp()), variant(std::move(val)) {}
+		value(const object &val)		: type(types::OBJECT),	stamp(next_stamp()), variant(val) {}
+		value(object &&val)				: type(types::OBJECT),	stamp(next_stamp()), variant(std::move(val)) {}
+
+		value(const value &) = default;
+		value& operator=(const value &) = default;
+
+		value(value &&v) noexcept(std::is_nothrow_move_constructible<__variant>::value)
+			: type(v.type), stamp(v.stamp), variant(std::move(v.variant))
+		{
+			v.stamp = 0;
+		}
+
+		value& operator=(value &&v) noexcept(std::is_nothrow_move_assignable<__variant>::value)
+		{
+			this->type = v.type;
+			this->stamp = v.stamp;
+			this->variant = std::move(v.variant);
+			if(&v != this)
+				v.stamp = 0;
+			return *this;
+		}
 
 		bool is_null()		{ return this->type == types::NILL; }
 		bool is_bool()		{ return this->type == types::BOOLEAN; }
@@ -81,15 +412,125 @@ namespace json
 			return boost::get<tCastType>(this->variant);
 		}
 		
+		static void feed_u64(boost::network::hashs::md5 &h, uint64_t v)
+		{
+			unsigned char bytes[8];
+			for(size_t i = 0; i < 8; i++)
+				bytes[i] = static_cast<unsigned char>(v >> (i * 8));
+			h.update(bytes, sizeof(bytes));
+		}
+		
+		static void feed_integer(boost::network::hashs::md5 &h, long long v)
+		{
+			h.update("i", 1);
+			feed_u64(h, static_cast<uint64_t>(v));
+		}
+		
+		// Digests of arrays and objects below come from cache when there's one
+		void feed(boost::network::hashs::md5 &h, hash_cache *cache) const;
+
+		digest compute(hash_cache *cache) const
+		{
+			boost::network::hashs::md5 h;
+			switch(this->type)
+			{
+			case types::ARRAY:
+			{
+				const array &arr = boost::get<array>(this->variant);
+				h.update("a", 1);
+				feed_u64(h, arr.size());
+				for(const value &v : arr)
+					v.feed(h, cache);
+				break;
+			}
+			case types::OBJECT:
+			{
+				const object &obj = boost::get<object>(this->variant);
+				h.update("o", 1);
+				feed_u64(h, obj.size());
+				for(const auto &m : obj)
+				{
+					feed_u64(h, m.first.to_string().size());
+					h.update(m.first.to_string().data(), m.first.to_string().size());
+					m.second.feed(h, cache);
+				}
+				break;
+			}
+			default:
+				this->feed(h, cache);
+			}
+			return h.finish();
+		}
+
+		// Exact digests tell integral reals from integers
+		void feed_scalar(boost::network::hashs::md5 &h, bool exact) const
+		{
+			switch(this->type)
+			{
+			case types::NONE:
+				h.update("x", 1);
+				break;
+			case types::NILL:
+				h.update("n", 1);
+				break;
+			case types::BOOLEAN:
+				h.update(boost::get<long long>(this->variant) != 0 ? "t" : "f", 1);
+				break;
+			case types::INTEGER:
+				feed_integer(h, boost::get<long long>(this->variant));
+				break;
+			case types::REAL:
+			{
+				// Integral reals hash like the integer they print as
+				const long double r = boost::get<long double>(this->variant);
+				if(!exact && r >= -9223372036854775808.0L && r < 9223372036854775808.0L && r == std::trunc(r))
+					feed_integer(h, static_cast<long long>(r));
+				else
+				{
+					// Sign, exponent and mantissa bits, no text that could
+					// depend on the locale
+					int exponent = 0;
+					const long double mantissa = std::isfinite(r) ? std::frexp(r, &exponent) : r;
+					h.update("r", 1);
+					h.update(std::signbit(r) ? "-" : "+", 1);
+					if(std::isnan(r))
+						h.update("n", 1);
+					else if(std::isinf(r))
+						h.update("i", 1);
+					else
+					{
+						feed_u64(h, static_cast<uint64_t>(static_cast<int64_t>(exponent)));
+						feed_u64(h, static_cast<uint64_t>(std::ldexp(std::fabs(mantissa), 64)));
+					}
+				}
+				break;
+			}
+			case types::STRING:
+			{
+				const std::string &str = this->to_string();
+				h.update("s", 1);
+				feed_u64(h, str.size());
+				h.update(str.data(), str.size());
+				break;
+			}
+			case types::ARRAY:
+			case types::OBJECT:
+				assert(false && "Not a scalar");
+				break;
+			}
+		}
+		
 		void array_add(const value &v)
 		{
 			assert(this->type == types::ARRAY);
+			this->touch();
 			boost::get<array&>(this->variant).push_back(v);
 		}
 		
-		void object_add(const std::string &k, const value &v)
+		void object_add(const key &k, const value &v)
 		{
 			assert(this->type == types::OBJECT);
+			this->touch();
 			//boost::get<object&>(this->variant).insert({k, v});
 			boost::get<object&>(this->variant).insert(std::make_pair(k, v));
 		}
@@ -113,21 +554,41 @@ namespace json
 			return this->cast<long double&>();
 		}
 		
-		std::string& to_string()
+		// Read only, a string shared through a string_table stays shared
+		const std::string& to_string() const
+		{
+			assert(this->type == types::STRING);
+			if(const string_table::handle *shared = boost::get<string_table::handle>(&this->variant))
+				return **shared;
+			return boost::get<std::string>(this->variant);
+		}
+
+		// For writing, a shared string gets its own copy first
+		std::string& edit_string()
 		{
 			assert(this->type == types::STRING);
+			if(const string_table::handle *shared = boost::get<string_table::handle>(&this->variant))
+				this->variant = std::string(**shared);
 			return this->cast<std::string&>();
 		}
 
+		// True if the string is shared through a string_table
+		bool shared_string() const
+		{
+			return boost::get<string_table::handle>(&this->variant) != nullptr;
+		}
+
 		array& to_array()
 		{
 			assert(this->type == types::ARRAY);
+			this->touch();
 			return this->cast<array&>();
 		}
 		
 		object& to_object()
 		{
 			assert(this->type == types::OBJECT);
+			this->touch();
 			return this->cast<object&>();
 		}
 
@@ -153,22 +614,292 @@ namespace json
 		value& get(unsigned int i)
 		{
 			assert(this->type == types::ARRAY);
+			this->touch();
 			return boost::get<array&>(this->variant).at(i);
 		}
 		
 		template<typename tVarType>
-		void add(const std::string &k, const tVarType &v)
+		void add(const key &k, const tVarType &v)
 		{
 			this->object_add(k, v);
 		}
 		
-		value& get(const std::string &k)
+		value& get(const key &k)
 		{
 			assert(this->type == types::OBJECT);
+			this->touch();
 			return boost::get<object&>(this->variant).at(k);
 		}
+		
+		value& get(const std::string &k)
+		{
+			return this->get(key::ref(k));
+		}
+		
+		template<size_t N>
+		value& get(const char (&k)[N])
+		{
+			return this->get(std::string(k));
+		}
+		
+		// Canonical md5 of the subtree: members in key order, integral reals
+		// hashed as integers. Nothing is kept between calls, see hash_cache.
+		digest hash() const
+		{
+			return this->compute(nullptr);
+		}
+
+		// Heap bytes asked from the allocator by a subtree, with libstdc++'s
+		// layouts; the allocator's own overhead isn't included
+		struct footprint
+		{
+			size_t nodes = 0;		// values in array buffers and object members
+			size_t containers = 0;	// array and object headers
+			size_t strings = 0;		// string value buffers, a string shared by values counted once
+			size_t keys = 0;		// member keys, a key shared by members counted once
+			size_t slack = 0;		// unused capacity, included in nodes and strings
+
+			size_t total() const
+			{
+				return this->nodes + this->containers + this->strings + this->keys;
+			}
+		};
+
+		footprint memory_usage() const
+		{
+			footprint ret;
+			std::unordered_set<const std::string*> shared;
+			this->measure(ret, shared);
+			return ret;
+		}
+
+		// Gives back unused capacity: arrays and strings are reallocated to
+		// their size
+		void shrink_to_fit()
+		{
+			this->shrink(nullptr, nullptr);
+		}
+
+		// Also shares the storage of equal keys, through keys
+		void shrink_to_fit(key_table &keys)
+		{
+			this->shrink(&keys, nullptr);
+		}
+
+		// And of equal string values, through strings. Only strings with a heap
+		// buffer are shared, each distinct one costs a shared block once.
+		void shrink_to_fit(key_table &keys, string_table &strings)
+		{
+			this->shrink(&keys, &strings);
+		}
+
+	private:
+		// Shared pointers from make_shared: counts and vtable, then the object
+		static size_t shared_size(size_t size)
+		{
+			return 2 * sizeof(void*) + size;
+		}
+
+		static size_t string_size(const std::string &str, footprint &f)
+		{
+			// Short strings use the buffer inside std::string, nothing on the heap
+			const char *data = str.data();
+			const char *self = reinterpret_cast<const char*>(&str);
+			if(data >= self && data < self + sizeof(str))
+				return 0;
+			f.slack += str.capacity() - str.size();
+			return str.capacity() + 1;
+		}
+
+		void measure(footprint &f, std::unordered_set<const std::string*> &shared) const
+		{
+			switch(this->type)
+			{
+			case types::STRING:
+			{
+				const std::string &str = this->to_string();
+				if(!this->shared_string())
+					f.strings += string_size(str, f);
+				else if(shared.insert(&str).second)
+					f.strings += shared_size(sizeof(std::string)) + string_size(str, f);
+				break;
+			}
+
+			case types::ARRAY:
+			{
+				const array &arr = boost::get<array>(this->variant);
+				f.containers += sizeof(array);
+				f.nodes += arr.capacity() * sizeof(value);
+				f.slack += (arr.capacity() - arr.size()) * sizeof(value);
+				for(const value &v : arr)
+					v.measure(f, shared);
+				break;
+			}
+
+			case types::OBJECT:
+			{
+				const object &obj = boost::get<object>(this->variant);
+				f.containers += sizeof(object);
+				for(const auto &m : obj)
+				{
+					// Tree node: color and three links, then the member
+					f.nodes += 4 * sizeof(void*) + sizeof(object::value_type);
+					// Plain keys are in the node, interned ones in a shared block
+					const std::string &k = m.first.to_string();
+					if(!m.first.interned())
+						f.keys += string_size(k, f);
+					else if(shared.insert(&k).second)
+						f.keys += shared_size(sizeof(std::string)) + string_size(k, f);
+					m.second.measure(f, shared);
+				}
+				break;
+			}
+
+			default:
+				break;
+			}
+		}
+
+		void shrink(key_table *keys, string_table *strings)
+		{
+			switch(this->type)
+			{
+			case types::STRING:
+			{
+				std::string *str = boost::get<std::string>(&this->variant);
+				if(str == nullptr)
+					break;
+				if(strings != nullptr && str->size() > std::string().capacity())
+					this->variant = strings->intern(*str);
+				else
+					str->shrink_to_fit();
+				break;
+			}
+
+			case types::ARRAY:
+			{
+				array &arr = boost::get<array>(this->variant);
+				if(arr.capacity() != arr.size())
+				{
+					// Moved explicitly, the vector would copy the subtrees
+					array trimmed;
+					trimmed.reserve(arr.size());
+					for(value &v : arr)
+						trimmed.push_back(std::move(v));
+					arr.swap(trimmed);
+				}
+				for(value &v : arr)
+					v.shrink(keys, strings);
+				break;
+			}
+
+			case types::OBJECT:
+			{
+				object &obj = boost::get<object>(this->variant);
+				bool interned = true;
+				for(auto &m : obj)
+				{
+					if(keys != nullptr && interned)
+					{
+						// Already as the table would give it: plain, or its storage
+						const key k = keys->intern(m.first);
+						interned = k.interned() ? k.same(m.first) : !m.first.interned();
+					}
+					m.second.shrink(keys, strings);
+				}
+
+				// Map keys are const, members go to a new map with the shared keys
+				if(!interned)
+				{
+					object rebuilt;
+					for(auto &m : obj)
+						rebuilt.emplace_hint(rebuilt.end(), keys->intern(m.first), std::move(m.second));
+					obj.swap(rebuilt);
+				}
+				break;
+			}
+
+			default:
+				break;
+			}
+		}
+	};
+
+	inline bool operator==(const value &a, const value &b)
+	{
+		// Shared and own strings compare by content
+		if(a.type == value::types::STRING && b.type == value::types::STRING)
+			return a.to_string() == b.to_string();
+		return a.type == b.type && a.variant == b.variant;
+	}
+
+	inline bool operator!=(const value &a, const value &b)
+	{
+		return !(a == b);
+	}
+
+	// Digests of the arrays and objects of a tree, kept between hash() calls
+	// so rehashing after a small change only recomputes what changed. Digests
+	// are kept by the stamp of their container, which copies share and get(),
+	// add(), to_array() and to_object() renew: going down from the root to
+	// change a value leaves every container above it to recompute, and a copy
+	// of a tree with a few changes reuses the digests of the rest. A reference
+	// kept from before a hash() and written through after it isn't seen,
+	// invalidate() the containers above it then. Neither are writes to the type
+	// and variant members. Digests of dropped values stay until clear().
+	class hash_cache
+	{
+	private:
+		bool exact;
+		std::unordered_map<uint64_t, value::digest> digests;
+
+	public:
+		// Exact digests also tell 1.0 from 1, as a diff keeping types needs
+		explicit hash_cache(bool _exact = false) : exact(_exact) {}
+
+		bool is_exact() const
+		{
+			return this->exact;
+		}
+
+		value::digest hash(const value &v)
+		{
+			if((v.type != value::types::ARRAY && v.type != value::types::OBJECT) || v.stamp == 0)
+				return v.compute(this);
+
+			auto it = this->digests.find(v.stamp);
+			if(it != this->digests.end())
+				return it->second;
+			const value::digest ret = v.compute(this);
+			this->digests.emplace(v.stamp, ret);
+			return ret;
+		}
+
+		// Gives the container a new stamp, its digest is computed again
+		void invalidate(value &v)
+		{
+			v.touch();
+		}
+
+		void clear()
+		{
+			this->digests.clear();
+		}
+
+		size_t size() const
+		{
+			return this->digests.size();
+		}
 	};
 
+	inline void value::feed(boost::network::hashs::md5 &h, hash_cache *cache) const
+	{
+		if(this->type != types::ARRAY && this->type != types::OBJECT)
+			return this->feed_scalar(h, cache && cache->is_exact());
+		h.update("d", 1);
+		h.update(cache ? cache->hash(*this) : this->compute(nullptr));
+	}
+
 	class parser
 	{
 	public:
@@ -183,10 +914,38 @@ namespace json
 		};
 		
 	private:
-		std::istream &stream;
+		std::istream *stream;
+		key_table *keys;
 		
 		int col, row;
 		
+		// Kept between parses, a reused parser doesn't allocate them again
+		std::string scratch_key, scratch_string, scratch_number;
+		value number;
+		
+		VITRINE_INSTRUMENT_ONLY(
+			instrument::counters stats;
+			uint64_t depth = 0;
+
+			void count(value::types t)
+			{
+				this->stats.values[static_cast<size_t>(t)]++;
+			}
+
+			void enter()
+			{
+				if(++this->depth > this->stats.max_depth)
+					this->stats.max_depth = this->depth;
+			}
+
+			void report()
+			{
+				this->stats.parses++;
+				instrument::record_parse(this->stats);
+				this->stats = instrument::counters();
+			}
+		)
+		
 		void error(const char *mess)
 		{
 			throw parsing_error(this->row, this->col, mess);
@@ -194,23 +953,24 @@ namespace json
 		
 		void check_status()
 		{
-			if(!stream.good())
+			if(!this->stream->good())
 				this->error("Unexpected end of stream");
 		}
 
 		void trim()
 		{
 			std::string spaces(" \t\n\r"); //FIXME Faster with regexp?
-			while(spaces.find(stream.peek()) != std::string::npos)
+			while(spaces.find(this->stream->peek()) != std::string::npos)
 			{
-				if(stream.peek() == '\n')
+				if(this->stream->peek() == '\n')
 				{
 					row++;
 					col = 1;
 				}
 				else
 					col++;
-				stream.get();
+				this->stream->get();
+				VITRINE_INSTRUMENT_ONLY(this->stats.parsed_bytes++;)
 				check_status();
 			}
 		}
@@ -218,13 +978,14 @@ namespace json
 		int next()
 		{
 			trim();
-			return stream.peek();
+			return this->stream->peek();
 		}
 		
 		int pop()
 		{
 			col++;
-			return stream.get();
+			VITRINE_INSTRUMENT_ONLY(this->stats.parsed_bytes++;)
+			return this->stream->get();
 		}
 		
 		int check_pop(const std::string &chars)
@@ -247,32 +1008,90 @@ namespace json
 			}
 		}
 		
-		std::string parse_unicode_sequence()
+		static int hex_digit(int c)
 		{
-			const char *test = "0123456789ABCDEFabcdef";
-		
-			std::stringstream buff;
-			uint16_t uc;
-			buff << (char)this->check_pop(test);
-			buff << (char)this->check_pop(test);
-			buff << (char)this->check_pop(test);
-			buff << (char)this->check_pop(test); //FIXME ugly?
-			buff >> std::hex >> uc;
-			
-			std::u16string us(1, uc);//FIXME Find a faster way than making a tmp string!
-			return boost::locale::conv::utf_to_utf<char>(us);
+			static const signed char digits[256] = {
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+				-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			};
+			return (c < 0 || c > 255) ? -1 : digits[c];
+		}
+
+		uint32_t parse_hex_quad()
+		{
+			uint32_t ret = 0;
+			for(int i = 0; i < 4; i++)
+			{
+				const int digit = hex_digit(this->pop());
+				if(digit < 0)
+					this->error("Invalid unicode escape sequence");
+				ret = (ret << 4) | digit;
+			}
+			return ret;
+		}
+
+		void parse_unicode_sequence(std::string &ret)
+		{
+			uint32_t cp = this->parse_hex_quad();
+
+			if(cp >= 0xD800 && cp <= 0xDBFF)
+			{
+				if(this->pop() != '\\' || this->pop() != 'u')
+					this->error("Unpaired unicode surrogate");
+
+				const uint32_t low = this->parse_hex_quad();
+				if(low < 0xDC00 || low > 0xDFFF)
+					this->error("Unpaired unicode surrogate");
+
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+			}
+			else if(cp >= 0xDC00 && cp <= 0xDFFF)
+				this->error("Unpaired unicode surrogate");
+
+			append_utf8(ret, cp);
 		}
 		
-		std::string parse_string()
+		// Decodes into ret, replacing its content but keeping its capacity
+		void parse_string(std::string &ret)
 		{
-			std::string ret;
+			VITRINE_INSTRUMENT_ONLY(instrument::timer t(this->stats.nanoseconds[instrument::STRINGS]);)
+			VITRINE_INSTRUMENT_ONLY(bool escaped = false;)
+			VITRINE_INSTRUMENT_ONLY(const size_t capacity = ret.capacity();)
+			ret.clear();
 			check_pop("\"");
-			
-			while(this->next() != '"')
+
+			// Read straight from the buffer, whitespace is part of the string
+			std::streambuf *buf = this->stream->rdbuf();
+			for(;;)
 			{
-				if(this->next() == '\\')
+				const int c = buf->sbumpc();
+				this->col++;
+				VITRINE_INSTRUMENT_ONLY(this->stats.parsed_bytes++;)
+
+				if(c == '"')
+					break;
+				else if(c == std::char_traits<char>::eof())
 				{
-					this->pop();
+					this->stream->setstate(std::ios::eofbit);
+					this->error("Unexpected end of stream");
+				}
+				else if(c == '\\')
+				{
+					VITRINE_INSTRUMENT_ONLY(escaped = true;)
 					switch(this->pop())
 					{
 					case '"': ret += '"'; break;
@@ -283,53 +1102,146 @@ namespace json
 					case 'n': ret += '\n'; break;
 					case 'r': ret += '\r'; break;
 					case 't': ret += '\t'; break;
-					case 'u': ret += parse_unicode_sequence(); break;
+					case 'u': parse_unicode_sequence(ret); break;
 					default:
 						this->error("Unknow escape sequence");
 					}
 				}
 				else
-					ret += this->pop();
+					ret += static_cast<char>(c);
 			}
-			
-			check_pop("\"");
-			return ret;
+
+			// Escapes always decode to valid sequences, this catches raw input bytes
+			if(!is_valid_utf8(ret.data(), ret.size()))
+				this->error("Invalid UTF-8 sequence");
+
+			VITRINE_INSTRUMENT_ONLY(
+				if(escaped)
+					this->stats.strings_escaped++;
+				if(ret.capacity() > capacity)
+					this->stats.allocations++;
+			)
 		}
 		
-		value parse_number()
+		void parse_number(value &target)
 		{
+			VITRINE_INSTRUMENT_ONLY(instrument::timer t(this->stats.nanoseconds[instrument::NUMBERS]);)
 			std::string chars("0123456789-+.eE");
-			std::string buff;
+			std::string &buff = this->scratch_number;
+			buff.clear();
 
 			while(chars.find(this->next()) != std::string::npos)
 				buff += this->pop();
 
-			value ret = value();
-			try
+			// strto*_l rather than lexical_cast, which allocates a stream for
+			// reals, in the C locale so a decimal comma doesn't stop at the dot
+			const char *begin = buff.c_str();
+			char *end = nullptr;
+			bool overflow;
+			errno = 0;
+			if(buff.find_first_of(".eE") != std::string::npos)
 			{
-				if(buff.find('.') != std::string::npos)
-					ret = boost::lexical_cast<long double>(buff);
-				else
-					ret = boost::lexical_cast<long long>(buff);
+				const long double val = strtold_l(begin, &end, c_locale());
+				// Underflows are rounded to 0 or a denormal, that's fine
+				overflow = errno == ERANGE && std::isinf(val);
+				target.variant = val;
+				target.type = value::types::REAL;
 			}
-			catch(boost::bad_lexical_cast &e)
+			else
 			{
-				this->error("Can't decode number");
+				target.variant = strtoll_l(begin, &end, 10, c_locale());
+				overflow = errno == ERANGE;
+				target.type = value::types::INTEGER;
 			}
-			return ret;
+			if(buff.empty() || end != begin + buff.size() || overflow)
+				this->error("Can't decode number");
+			VITRINE_INSTRUMENT_ONLY(this->count(target.type);)
 		}
 		
-		value parse_value()
+		// Where dispatch() puts the value it reads: into a tree, reusing the
+		// string or containers the target already holds...
+		struct tree_sink
+		{
+			parser &p;
+			value &target;
+
+			void object()	{ this->p.parse_object(this->target); }
+			void array()	{ this->p.parse_array(this->target); }
+			void number()	{ this->p.parse_number(this->target); }
+			void null()		{ this->target.variant = 0LL; this->target.type = value::types::NILL; }
+
+			void boolean(bool b)
+			{
+				this->target.variant = static_cast<long long>(b);
+				this->target.type = value::types::BOOLEAN;
+			}
+
+			void string()
+			{
+				if(boost::get<std::string>(&this->target.variant) == nullptr)
+					this->target.variant = std::string();
+				this->p.parse_string(boost::get<std::string>(this->target.variant));
+				this->target.type = value::types::STRING;
+			}
+		};
+
+		// ...or as events of a handler
+		template<typename tHandler>
+		struct event_sink
+		{
+			parser &p;
+			tHandler &handler;
+
+			void object()			{ this->p.emit_object(this->handler); }
+			void array()			{ this->p.emit_array(this->handler); }
+			void null()				{ this->handler.null(); }
+			void boolean(bool b)	{ this->handler.boolean(b); }
+
+			void string()
+			{
+				this->p.parse_string(this->p.scratch_string);
+				this->handler.string(this->p.scratch_string);
+			}
+
+			void number()
+			{
+				this->p.parse_number(this->p.number);
+				if(this->p.number.type == value::types::INTEGER)
+					this->handler.integer(boost::get<long long>(this->p.number.variant));
+				else
+					this->handler.real(boost::get<long double>(this->p.number.variant));
+			}
+		};
+
+		// Events going nowhere, for the values of duplicated keys. Nothing is
+		// built, dropped values can nest duplicates of their own.
+		struct skip_handler
+		{
+			void begin_object()				{}
+			void end_object()				{}
+			void begin_array()				{}
+			void end_array()				{}
+			void key(const std::string &)	{}
+			void null()						{}
+			void boolean(bool)				{}
+			void integer(long long)			{}
+			void real(long double)			{}
+			void string(const std::string &)	{}
+		};
+
+		// Reads the next value, whose first character tells the type
+		template<typename tSink>
+		void dispatch(tSink &sink)
 		{
 			switch(this->next())
 			{
-			case '{': return parse_object();
-			case '[': return parse_array();
-			case '"': return parse_string();
+			case '{': VITRINE_INSTRUMENT_ONLY(this->count(value::types::OBJECT);) sink.object(); return;
+			case '[': VITRINE_INSTRUMENT_ONLY(this->count(value::types::ARRAY);) sink.array(); return;
+			case '"': VITRINE_INSTRUMENT_ONLY(this->count(value::types::STRING);) sink.string(); return;
 			
-			case 't': check_pop_string("true"); return true;
-			case 'f': check_pop_string("false"); return false;
-			case 'n': check_pop_string("null"); return value();
+			case 't': VITRINE_INSTRUMENT_ONLY(this->count(value::types::BOOLEAN);) check_pop_string("true"); sink.boolean(true); return;
+			case 'f': VITRINE_INSTRUMENT_ONLY(this->count(value::types::BOOLEAN);) check_pop_string("false"); sink.boolean(false); return;
+			case 'n': VITRINE_INSTRUMENT_ONLY(this->count(value::types::NILL);) check_pop_string("null"); sink.null(); return;
 			
 			case '0':
 			case '1':
@@ -342,96 +1254,393 @@ namespace json
 			case '8':
 			case '9':
 			case '-':
-				return parse_number();
+				// Counted once its type is known
+				sink.number();
+				return;
 			
 			default:
 				this->error("Unexpected character");
 			}
-			return value();
 		}
 
-		object parse_object()
+		// begin_document() is optional, the int overload is preferred if it's there
+		template<typename tHandler>
+		static auto begin_document(tHandler &handler, int) -> decltype(handler.begin_document())
+		{
+			return handler.begin_document();
+		}
+
+		template<typename tHandler>
+		static void begin_document(tHandler &, long) {}
+
+		// Reads the whole document, which must be an object or an array
+		template<typename tSink>
+		void dispatch_root(tSink &sink)
 		{
-			object obj;
+			{
+				VITRINE_INSTRUMENT_ONLY(instrument::timer t(this->stats.nanoseconds[instrument::PARSE]);)
+				const int c = this->next();
+				if(c != '{' && c != '[')
+					this->error("JSON Root neither an object nor an array");
+				this->dispatch(sink);
+			}
+			VITRINE_INSTRUMENT_ONLY(this->report();)
+		}
+
+		void parse_value(value &target)
+		{
+			tree_sink sink = {*this, target};
+			this->dispatch(sink);
+		}
+
+		// Parses members up to the end character, left in the stream. Members
+		// already in obj are parsed into when their key comes again, and removed
+		// if it doesn't.
+		void parse_members(object &obj, int end)
+		{
+			const bool reused = !obj.empty();
+			for(auto &m : obj)
+				m.second.type = value::types::NONE;
 			
-			check_pop("{");
-			while(this->next() != '}')
+			while(this->next() != end)
 			{
-				std::string k = parse_string();
+				parse_string(this->scratch_key);
 				check_pop(":");
 			
-				//obj.insert({k, parse_value()});
-				obj.insert(std::make_pair(k, parse_value()));
+				auto it = obj.find(key::ref(this->scratch_key));
+				if(it == obj.end())
+				{
+					VITRINE_INSTRUMENT_ONLY(const size_t interned = this->keys ? this->keys->size() : 0;)
+					it = obj.insert(std::make_pair(this->keys ? this->keys->intern(this->scratch_key) : key(this->scratch_key), value())).first;
+					it->second.type = value::types::NONE;
+					VITRINE_INSTRUMENT_ONLY(
+						// The member, and a key new to the table or a copy too long
+						// for the string's own buffer
+						this->stats.allocations++;
+						if(this->keys ? this->keys->size() > interned : this->scratch_key.size() > std::string().capacity())
+							this->stats.allocations++;
+					)
+				}
+				
+				// The first of duplicated keys wins, the others are read and dropped
+				if(it->second.type == value::types::NONE)
+					parse_value(it->second);
+				else
+				{
+					skip_handler skip;
+					this->emit_value(skip);
+				}
 				if(this->next() == ',')
 					this->pop();
 				this->trim();
 			}
+			
+			if(reused)
+			{
+				for(auto it = obj.begin(); it != obj.end();)
+					it = it->second.type == value::types::NONE ? obj.erase(it) : std::next(it);
+			}
+		}
+
+		// Parses elements up to the end character, left in the stream. Elements
+		// already in arr are parsed into, the ones left over are removed.
+		void parse_elements(array &arr, int end)
+		{
+			size_t size = 0;
+			while(this->next() != end)
+			{
+				if(size == arr.size())
+				{
+					VITRINE_INSTRUMENT_ONLY(
+						if(arr.size() == arr.capacity())
+							this->stats.allocations++;
+					)
+					arr.emplace_back();
+				}
+				parse_value(arr[size++]);
+				if(this->next() == ',')
+					this->pop();
+				this->trim();
+			}
+			arr.erase(arr.begin() + size, arr.end());
+		}
+
+		void parse_object(value &target)
+		{
+			if(boost::get<object>(&target.variant) == nullptr)
+			{
+				target.variant = object();
+				VITRINE_INSTRUMENT_ONLY(this->stats.allocations++;)
+			}
+			target.type = value::types::OBJECT;
+			target.touch();
+			VITRINE_INSTRUMENT_ONLY(this->enter();)
+			
+			check_pop("{");
+			this->parse_members(boost::get<object>(target.variant), '}');
 			check_pop("}");
 			
-			return obj;
+			VITRINE_INSTRUMENT_ONLY(this->depth--;)
 		}
 
-		array parse_array()
+		void parse_array(value &target)
 		{
-			array arr;
+			if(boost::get<array>(&target.variant) == nullptr)
+			{
+				target.variant = array();
+				VITRINE_INSTRUMENT_ONLY(this->stats.allocations++;)
+			}
+			target.type = value::types::ARRAY;
+			target.touch();
+			VITRINE_INSTRUMENT_ONLY(this->enter();)
 			
 			check_pop("[");
+			this->parse_elements(boost::get<array>(target.variant), ']');
+			check_pop("]");
+			
+			VITRINE_INSTRUMENT_ONLY(this->depth--;)
+		}
+
+		template<typename tHandler>
+		void emit_value(tHandler &handler)
+		{
+			event_sink<tHandler> sink = {*this, handler};
+			this->dispatch(sink);
+		}
+
+		template<typename tHandler>
+		void emit_object(tHandler &handler)
+		{
+			VITRINE_INSTRUMENT_ONLY(this->enter();)
+			check_pop("{");
+			handler.begin_object();
+			while(this->next() != '}')
+			{
+				parse_string(this->scratch_key);
+				check_pop(":");
+				handler.key(this->scratch_key);
+				this->emit_value(handler);
+				if(this->next() == ',')
+					this->pop();
+				this->trim();
+			}
+			check_pop("}");
+			handler.end_object();
+			VITRINE_INSTRUMENT_ONLY(this->depth--;)
+		}
+
+		template<typename tHandler>
+		void emit_array(tHandler &handler)
+		{
+			VITRINE_INSTRUMENT_ONLY(this->enter();)
+			check_pop("[");
+			handler.begin_array();
 			while(this->next() != ']')
 			{
-				arr.push_back(parse_value());
+				this->emit_value(handler);
 				if(this->next() == ',')
 					this->pop();
 				this->trim();
 			}
 			check_pop("]");
-			
-			return arr;
+			handler.end_array();
+			VITRINE_INSTRUMENT_ONLY(this->depth--;)
 		}
 
+		friend class parallel_parser;
+
 	public:
-		parser(std::istream &_stream) : stream(_stream), col(1), row(1) {}
+		parser(std::istream &_stream) : stream(&_stream), keys(nullptr), col(1), row(1) {}
+		
+		// Object keys are interned in _keys, shared by every object of the document
+		parser(std::istream &_stream, key_table &_keys) : stream(&_stream), keys(&_keys), col(1), row(1) {}
+		
+		// Without a stream yet, reset() must be called before parsing
+		explicit parser(key_table &_keys) : stream(nullptr), keys(&_keys), col(1), row(1) {}
+		
+		// Parses another stream, keeping the buffers grown so far
+		void reset(std::istream &_stream)
+		{
+			this->stream = &_stream;
+			this->col = 1;
+			this->row = 1;
+			VITRINE_INSTRUMENT_ONLY(
+				this->stats = instrument::counters();
+				this->depth = 0;
+			)
+		}
+		
+		// Parses into target, reusing the strings and containers it holds when
+		// the document has the same shape. On error target is left half parsed.
+		void parse_into(value &target)
+		{
+			tree_sink sink = {*this, target};
+			this->dispatch_root(sink);
+		}
 		
 		value parse()
 		{
-			switch(this->next())
-			{
-			case '{': return parse_object();
-			case '[': return parse_array();
-			default:
-				this->error("JSON Root neither an object nor an array");
-			}
-			return value();
+			value ret;
+			this->parse_into(ret);
+			return ret;
+		}
+		
+		// Reports the document to handler as it's read instead of building it,
+		// through begin_object(), key(const std::string&), end_object(),
+		// begin_array(), end_array(), null(), boolean(bool), integer(long long),
+		// real(long double) and string(const std::string&). Strings are only
+		// valid during the call. Handlers stop the parse by throwing. Handlers
+		// with a begin_document() get it first, to drop what a previous
+		// document left half way.
+		template<typename tHandler>
+		void parse(tHandler &handler)
+		{
+			begin_document(handler, 0);
+			event_sink<tHandler> sink = {*this, handler};
+			this->dispatch_root(sink);
 		}
 	};
 
 	inline std::ostream& operator<<(std::ostream &o, const json::array &arr);
 	inline std::ostream& operator<<(std::ostream &o, const json::object &obj);
 	
-	inline std::ostream& print_escaped_string(std::ostream &o, const std::string &str)
+	// Writes str quoted and escaped into anything with write(const char*, size),
+	// unescaped runs are copied in one call
+	template<typename tSink>
+	void escape_to(tSink &sink, const char *str, size_t size)
 	{
-		o << "\"";
-		for(char c : str)
+		static const char hex[] = "0123456789abcdef";
+		
+		sink.write("\"", 1);
+		size_t run = 0;
+		for(size_t i = 0; i < size; i++)
 		{
+			const unsigned char c = static_cast<unsigned char>(str[i]);
+			if(c >= 0x20 && c != '"' && c != '\\' && c != '/')
+				continue;
+			
+			sink.write(str + run, i - run);
+			run = i + 1;
 			switch(c)
 			{
-			case '"':	o << "\\\""; break;
-			case '\\':	o << "\\\\"; break;
-			case '/': 	o << "\\/"; break;
-			case '\b':	o << "\\b"; break;
-			case '\f':	o << "\\f"; break;
-			case '\n':	o << "\\n"; break;
-			case '\r':	o << "\\r"; break;
-			case '\t':	o << "\\t"; break;
+			case '"':	sink.write("\\\"", 2); break;
+			case '\\':	sink.write("\\\\", 2); break;
+			case '/': 	sink.write("\\/", 2); break;
+			case '\b':	sink.write("\\b", 2); break;
+			case '\f':	sink.write("\\f", 2); break;
+			case '\n':	sink.write("\\n", 2); break;
+			case '\r':	sink.write("\\r", 2); break;
+			case '\t':	sink.write("\\t", 2); break;
 			
 			default:
-				//FIXME Handle unicode
-				o << c;
+			{
+				const char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+				sink.write(u, sizeof(u));
+			}
 			}
 		}
-		o << "\"";
+		sink.write(str + run, size - run);
+		sink.write("\"", 1);
+	}
+	
+	// Formats into buffer and returns the length, with the fewest digits that
+	// read back the same value: 0.1 rather than 0.10000000000000001, 5.0e-324
+	// rather than 4.94065645841247e-324. Values that are doubles read back as
+	// the same double, others as the same long double. Reals always keep a
+	// dot so they're parsed as reals again, and JSON has no infinity or NaN.
+	inline size_t format_real(char (&buffer)[32], long double val)
+	{
+		if(!std::isfinite(val))
+		{
+			std::memcpy(buffer, "null", 4);
+			return 4;
+		}
+		
+		c_locale_scope c;
+		const bool is_double = static_cast<long double>(static_cast<double>(val)) == val;
+
+		// Any shorter text that reads back the same is also what rounding to
+		// 15 digits for a double, 18 for a long double, writes once trailing
+		// zeros are dropped, so those are tried first. Subnormals have fewer
+		// bits, they start from a single digit.
+		const bool subnormal = (is_double ? std::fpclassify(static_cast<double>(val)) : std::fpclassify(val)) == FP_SUBNORMAL;
+		const int most = is_double ? 17 : 21;
+		int precision = subnormal ? 1 : is_double ? 15 : 18;
+		for(;; precision++)
+		{
+			std::snprintf(buffer, sizeof(buffer), "%.*Le", precision - 1, val);
+			const long double back = std::strtold(buffer, nullptr);
+			if(precision == most || (is_double ? static_cast<double>(back) == static_cast<double>(val) : back == val))
+				break;
+		}
+
+		// Digits left once trailing zeros are dropped, and the exponent
+		const char *first = buffer + (buffer[0] == '-');
+		const char *mark = std::strchr(buffer, 'e');
+		const char *last = mark - 1;
+		while(last > first && (*last == '0' || *last == '.'))
+			last--;
+		const int digits = last == first ? 1 : last - first;	// the dot isn't one
+		const int exponent = std::atoi(mark + 1);
+
+		// Written out below 1e15, 100.0 rather than 1.0e+02, with %g taking
+		// an exponent from as many digits as the precision
+		precision = exponent >= -4 && exponent < 15 ? std::max(digits, exponent + 1) : digits;
+		int len = std::snprintf(buffer, sizeof(buffer), "%.*Lg", precision, val);
+		if(std::memchr(buffer, '.', len) == nullptr)
+		{
+			char *exp = static_cast<char*>(std::memchr(buffer, 'e', len));
+			const size_t at = exp == nullptr ? len : exp - buffer;
+			std::memmove(buffer + at + 2, buffer + at, len - at);
+			buffer[at] = '.';
+			buffer[at + 1] = '0';
+			len += 2;
+		}
+		return len;
+	}
+	
+	inline size_t format_integer(char (&buffer)[32], unsigned long long val, bool negative = false)
+	{
+		// Digits from the end, then moved to the front
+		char *end = buffer + sizeof(buffer);
+		char *p = end;
+		do
+		{
+			*--p = static_cast<char>('0' + val % 10);
+			val /= 10;
+		} while(val != 0);
+		if(negative)
+			*--p = '-';
+		
+		std::memmove(buffer, p, end - p);
+		return end - p;
+	}
+	
+	inline size_t format_integer(char (&buffer)[32], long long val)
+	{
+		// Negated unsigned so the smallest long long doesn't overflow
+		return val < 0 ? format_integer(buffer, 0ull - static_cast<unsigned long long>(val), true)
+			: format_integer(buffer, static_cast<unsigned long long>(val));
+	}
+	
+	inline std::ostream& print_escaped_string(std::ostream &o, const std::string &str)
+	{
+		escape_to(o, str.data(), str.size());
 		return o;
 	}
 
+	inline std::ostream& print_integer(std::ostream &o, long long val)
+	{
+		char buffer[32];
+		return o.write(buffer, format_integer(buffer, val));
+	}
+
+	inline std::ostream& print_real(std::ostream &o, long double val)
+	{
+		char buffer[32];
+		return o.write(buffer, format_real(buffer, val));
+	}
+
 	inline std::ostream& operator<<(std::ostream &o, const json::value &val)
 	{
 		switch(val.type)
@@ -439,9 +1648,9 @@ namespace json
 		case json::value::types::NONE:		return o;
 		case json::value::types::NILL:		return o << "null";
 		case json::value::types::BOOLEAN:	return o << ((boost::get<long long>(val.variant) != 0.) ? "true" : "false");
-		case json::value::types::INTEGER:	return o << boost::get<long long>(val.variant);
-		case json::value::types::REAL:		return o << boost::get<double>(val.variant);
-		case json::value::types::STRING:	return print_escaped_string(o, boost::get<std::string>(val.variant));
+		case json::value::types::INTEGER:	return print_integer(o, boost::get<long long>(val.variant));
+		case json::value::types::REAL:		return print_real(o, boost::get<long double>(val.variant));
+		case json::value::types::STRING:	return print_escaped_string(o, val.to_string());
 		case json::value::types::ARRAY:		return o << boost::get<json::array>(val.variant);
 		case json::value::types::OBJECT:	return o << boost::get<json::object>(val.variant);
 		}
@@ -475,7 +1684,7 @@ namespace json
 		{
 			if(it != obj.cbegin())
 				o << ", ";
-			o << '"' << (*it).first << "\" : " << (*it).second;
+			print_escaped_string(o, (*it).first) << " : " << (*it).second;
 		}
 		return o << "}";
 	}
@@ -0,0 +1,400 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "json.hpp"
+
+namespace json
+{
+	class columns_error : public std::runtime_error
+	{
+	public:
+		columns_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	// One field of an array of records, stored contiguously. Null or missing
+	// values have their bit set in nulls and a zero (or empty string) in the
+	// data, so sums can run over the data without looking at the bitmap.
+	class column
+	{
+	public:
+		enum class kinds
+		{
+			NONE,		// only nulls so far
+			INTEGER,
+			REAL,		// integers are promoted if a real shows up
+			BOOLEAN,
+			STRING,
+		};
+
+		std::string name;
+		kinds kind = kinds::NONE;
+		size_t length = 0;
+
+		std::vector<int64_t> integers;
+		std::vector<double> reals;
+		std::vector<uint8_t> booleans;
+		std::vector<uint64_t> offsets;	// length + 1 offsets in blob
+		std::string blob;
+		std::vector<uint64_t> nulls;	// one bit per row
+
+	private:
+		friend class column_extractor;
+
+		void mark_null()
+		{
+			if(this->nulls.size() * 64 <= this->length)
+				this->nulls.push_back(0);
+			this->nulls[this->length / 64] |= 1ull << (this->length % 64);
+		}
+
+		void append_null()
+		{
+			this->mark_null();
+			switch(this->kind)
+			{
+			case kinds::NONE:		break;
+			case kinds::INTEGER:	this->integers.push_back(0); break;
+			case kinds::REAL:		this->reals.push_back(0); break;
+			case kinds::BOOLEAN:	this->booleans.push_back(0); break;
+			case kinds::STRING:		this->offsets.push_back(this->blob.size()); break;
+			}
+			this->length++;
+		}
+
+		// Types the column on its first value, rows so far are nulls
+		void settle(kinds k)
+		{
+			if(this->kind == k)
+				return;
+
+			if(this->kind == kinds::INTEGER && k == kinds::REAL)
+			{
+				this->reals.assign(this->integers.begin(), this->integers.end());
+				this->integers = std::vector<int64_t>();
+			}
+			else if(this->kind == kinds::NONE)
+			{
+				switch(k)
+				{
+				case kinds::NONE:		break;
+				case kinds::INTEGER:	this->integers.resize(this->length); break;
+				case kinds::REAL:		this->reals.resize(this->length); break;
+				case kinds::BOOLEAN:	this->booleans.resize(this->length); break;
+				case kinds::STRING:		this->offsets.resize(this->length + 1); break;
+				}
+			}
+			else
+				throw columns_error("Mixed types in field " + this->name);
+			this->kind = k;
+		}
+
+		void grow()
+		{
+			if(this->nulls.size() * 64 <= this->length)
+				this->nulls.push_back(0);
+			this->length++;
+		}
+
+		void append(long long v)
+		{
+			if(this->kind == kinds::REAL)
+				return this->append(static_cast<long double>(v));
+			this->settle(kinds::INTEGER);
+			this->integers.push_back(v);
+			this->grow();
+		}
+
+		void append(long double v)
+		{
+			this->settle(kinds::REAL);
+			this->reals.push_back(static_cast<double>(v));
+			this->grow();
+		}
+
+		void append(bool v)
+		{
+			this->settle(kinds::BOOLEAN);
+			this->booleans.push_back(v);
+			this->grow();
+		}
+
+		void append(const std::string &v)
+		{
+			this->settle(kinds::STRING);
+			this->blob += v;
+			this->offsets.push_back(this->blob.size());
+			this->grow();
+		}
+
+	public:
+		column(const std::string &_name) : name(_name)
+		{
+			this->offsets.push_back(0);
+		}
+
+		size_t size() const
+		{
+			return this->length;
+		}
+
+		bool is_null(size_t row) const
+		{
+			return (this->nulls[row / 64] >> (row % 64)) & 1;
+		}
+
+		std::string get_string(size_t row) const
+		{
+			assert(this->kind == kinds::STRING);
+			return this->blob.substr(this->offsets[row], this->offsets[row + 1] - this->offsets[row]);
+		}
+
+		size_t count_nulls() const
+		{
+			size_t ret = 0;
+			for(uint64_t word : this->nulls)
+				ret += __builtin_popcountll(word);
+			return ret;
+		}
+
+		// Sums skip nulls for free, their slots hold zeros
+		int64_t sum_integers() const
+		{
+			const int64_t *it = this->integers.data();
+			const int64_t *end = it + this->integers.size();
+			int64_t ret = 0;
+#ifdef __SSE2__
+			__m128i a = _mm_setzero_si128(), b = _mm_setzero_si128();
+			for(; end - it >= 4; it += 4)
+			{
+				a = _mm_add_epi64(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(it)));
+				b = _mm_add_epi64(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(it + 2)));
+			}
+			int64_t lanes[2];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(a, b));
+			ret = lanes[0] + lanes[1];
+#endif
+			for(; it != end; it++)
+				ret += *it;
+			return ret;
+		}
+
+		// Summed in several lanes, the rounding may differ from a serial sum
+		double sum_reals() const
+		{
+			const double *it = this->reals.data();
+			const double *end = it + this->reals.size();
+			double ret = 0;
+#ifdef __SSE2__
+			__m128d a = _mm_setzero_pd(), b = _mm_setzero_pd();
+			for(; end - it >= 4; it += 4)
+			{
+				a = _mm_add_pd(a, _mm_loadu_pd(it));
+				b = _mm_add_pd(b, _mm_loadu_pd(it + 2));
+			}
+			double lanes[2];
+			_mm_storeu_pd(lanes, _mm_add_pd(a, b));
+			ret = lanes[0] + lanes[1];
+#endif
+			for(; it != end; it++)
+				ret += *it;
+			return ret;
+		}
+	};
+
+	class columns
+	{
+	public:
+		size_t rows = 0;
+		std::vector<column> fields;
+
+		const column& get(const std::string &name) const
+		{
+			for(const column &c : this->fields)
+			{
+				if(c.name == name)
+					return c;
+			}
+			throw std::out_of_range("No such column: " + name);
+		}
+	};
+
+	// Parser handler turning a root array of objects into columns, without
+	// building the records. Scalar members become columns, nested arrays and
+	// objects are skipped unless a field list asks for them, which is an error.
+	class column_extractor
+	{
+	private:
+		columns result;
+		std::unordered_map<std::string, size_t> indexes;
+		bool projected;
+
+		// Columns filled by the current record, and its members seen so far
+		std::vector<bool> filled;
+		size_t position = 0;
+		std::vector<size_t> order;	// column of each position in the previous record
+
+		size_t depth = 0;
+		size_t current = npos();
+		std::string pending;	// key of current when it has no column yet
+
+		static size_t npos()
+		{
+			return static_cast<size_t>(-1);
+		}
+
+		size_t lookup(const std::string &k)
+		{
+			// Records tend to list members in the same order, try that first
+			if(this->position < this->order.size())
+			{
+				const size_t guess = this->order[this->position];
+				if(guess != npos() && this->result.fields[guess].name == k)
+					return guess;
+			}
+
+			auto it = this->indexes.find(k);
+			return it == this->indexes.end() ? npos() : it->second;
+		}
+
+		// Columns only appear with their first scalar, not for nested values
+		size_t add(const std::string &name)
+		{
+			this->indexes[name] = this->result.fields.size();
+			this->result.fields.push_back(column(name));
+			for(size_t i = 0; i < this->result.rows; i++)
+				this->result.fields.back().append_null();
+			this->filled.push_back(false);
+			return this->result.fields.size() - 1;
+		}
+
+		template<typename tValue>
+		void scalar(const tValue &v)
+		{
+			if(this->depth == 1)
+				throw columns_error("Record isn't an object");
+			if(this->depth != 2)
+				return;
+			if(this->current == npos())
+			{
+				if(this->projected)
+					return;
+				this->current = this->add(this->pending);
+			}
+
+			if(this->filled[this->current])
+				throw columns_error("Duplicated field " + this->result.fields[this->current].name);
+			this->result.fields[this->current].append(v);
+			this->filled[this->current] = true;
+		}
+
+		void nested()
+		{
+			if(this->depth == 2 && this->current != npos() && this->projected)
+				throw columns_error("Field " + this->result.fields[this->current].name + " isn't a scalar");
+			this->depth++;
+		}
+
+	public:
+		// Every scalar member, in order of appearance
+		column_extractor() : projected(false) {}
+
+		// Only the listed fields, which are all present in the result
+		column_extractor(const std::vector<std::string> &fields) : projected(true)
+		{
+			for(const std::string &f : fields)
+				this->add(f);
+		}
+
+		void begin_object()
+		{
+			if(this->depth == 0)
+				throw columns_error("Root isn't an array");
+			if(this->depth != 1)
+				return this->nested();
+
+			this->depth++;
+			this->position = 0;
+		}
+
+		void key(const std::string &k)
+		{
+			if(this->depth != 2)
+				return;
+
+			this->current = this->lookup(k);
+			if(this->current == npos())
+				this->pending = k;
+			if(this->position == this->order.size())
+				this->order.push_back(this->current);
+			else
+				this->order[this->position] = this->current;
+			this->position++;
+		}
+
+		void end_object()
+		{
+			if(--this->depth != 1)
+				return;
+
+			for(size_t i = 0; i < this->result.fields.size(); i++)
+			{
+				if(!this->filled[i])
+					this->result.fields[i].append_null();
+				this->filled[i] = false;
+			}
+			this->result.rows++;
+		}
+
+		void begin_array()
+		{
+			if(this->depth == 1)
+				throw columns_error("Record isn't an object");
+			if(this->depth != 0)
+				return this->nested();
+			this->depth++;
+		}
+
+		void end_array()
+		{
+			this->depth--;
+		}
+
+		void null()
+		{
+			if(this->depth == 1)
+				throw columns_error("Record isn't an object");
+		}
+
+		void boolean(bool v)				{ this->scalar(v); }
+		void integer(long long v)			{ this->scalar(v); }
+		void real(long double v)			{ this->scalar(v); }
+		void string(const std::string &v)	{ this->scalar(v); }
+
+		columns& get()
+		{
+			return this->result;
+		}
+	};
+
+	// Columns of a document made of a root array of records
+	inline columns extract_columns(std::istream &stream)
+	{
+		column_extractor e;
+		parser(stream).parse(e);
+		return std::move(e.get());
+	}
+
+	inline columns extract_columns(std::istream &stream, const std::vector<std::string> &fields)
+	{
+		column_extractor e(fields);
+		parser(stream).parse(e);
+		return std::move(e.get());
+	}
+} //namespace json
@@ -0,0 +1,124 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <memory>
+
+#include "json.hpp"
+
+namespace json
+{
+	// A document meant to be parsed again and again: its parser, key table and
+	// tree are kept, each parse() refills the tree in place. Once documents of
+	// the same shape have been seen, parsing one doesn't allocate anymore.
+	// Documents with ever new keys would grow the key table forever, it's
+	// dropped by reset() past max_keys.
+	class document
+	{
+	private:
+		key_table keys;
+		parser p;
+		value root;
+		size_t max_keys;
+
+	public:
+		explicit document(size_t _max_keys = 1 << 16) : p(keys), max_keys(_max_keys)
+		{
+			this->root.type = value::types::NONE;
+		}
+
+		document(const document&) = delete;
+		document& operator=(const document&) = delete;
+
+		value& parse(std::istream &stream)
+		{
+			this->p.reset(stream);
+			this->p.parse_into(this->root);
+			return this->root;
+		}
+
+		value& get()
+		{
+			return this->root;
+		}
+
+		// Empties the document, its storage is kept for the next parse unless
+		// the key table grew past max_keys
+		void reset()
+		{
+			if(this->keys.size() > this->max_keys)
+				this->release();
+			else
+				this->root.type = value::types::NONE;
+		}
+
+		// Frees the tree and the keys, when the next documents won't look alike
+		void release()
+		{
+			this->root = value();
+			this->root.type = value::types::NONE;
+			this->keys.clear();
+		}
+
+		size_t key_count() const
+		{
+			return this->keys.size();
+		}
+	};
+
+	// Documents recycled on a single thread, see local(). Handles give their
+	// document back when destroyed and must not leave the thread.
+	class document_pool
+	{
+	private:
+		std::vector<std::unique_ptr<document>> documents;
+
+	public:
+		class handle
+		{
+		private:
+			document_pool *pool;
+			std::unique_ptr<document> doc;
+
+		public:
+			handle(document_pool &_pool, std::unique_ptr<document> &&_doc) : pool(&_pool), doc(std::move(_doc)) {}
+			handle(handle &&) = default;
+
+			~handle()
+			{
+				if(this->doc)
+				{
+					this->doc->reset();
+					this->pool->documents.push_back(std::move(this->doc));
+				}
+			}
+
+			document& operator*()	{ return *this->doc; }
+			document* operator->()	{ return this->doc.get(); }
+		};
+
+		handle acquire()
+		{
+			if(this->documents.empty())
+				return handle(*this, std::unique_ptr<document>(new document()));
+
+			handle ret(*this, std::move(this->documents.back()));
+			this->documents.pop_back();
+			return ret;
+		}
+
+		size_t size() const
+		{
+			return this->documents.size();
+		}
+
+		static document_pool& local()
+		{
+			static thread_local document_pool pool;
+			return pool;
+		}
+	};
+} //namespace json
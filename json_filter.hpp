@@ -0,0 +1,531 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "json.hpp"
+#include "json_writer.hpp"
+
+namespace json
+{
+	class filter_error : public std::runtime_error
+	{
+	public:
+		filter_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	// Parser handler keeping the records of a document that match predicates,
+	// with only the selected fields, and writing them as an array to a writer.
+	// Records are the objects of the array found by following a dotted path
+	// of keys from the root (the root itself by default), paths in records
+	// name fields by dotted keys too and don't go through arrays.
+	// Nothing is built: a record is captured as events, only its selected
+	// parts, then written if it passed, and the capture is reused.
+	class filter
+	{
+	public:
+		// Values of different types are unordered and unequal, a missing field
+		// fails any predicate
+		enum class comparison
+		{
+			EQUAL,
+			NOT_EQUAL,
+			LESS,
+			LESS_EQUAL,
+			GREATER,
+			GREATER_EQUAL,
+		};
+
+	private:
+		enum class kinds
+		{
+			BEGIN_OBJECT,
+			END_OBJECT,
+			BEGIN_ARRAY,
+			END_ARRAY,
+			KEY,
+			NIL,
+			BOOLEAN,
+			INTEGER,
+			REAL,
+			STRING,
+		};
+
+		struct event
+		{
+			kinds kind;
+			long long integer;
+			long double real;
+			size_t offset, length;	// in text, for keys and strings
+		};
+
+		struct predicate
+		{
+			comparison op;
+			json::value operand;
+		};
+
+		// One node per field named by select() or where(), the record is node 0
+		struct node
+		{
+			std::vector<std::pair<std::string, size_t>> children;
+			bool selected = false;
+			bool projects = false;	// selected, or a field below is
+			std::vector<size_t> predicates;
+		};
+
+		enum class roles
+		{
+			OUTER,		// object on the path to the records, node is the depth
+			RECORDS,	// the array of records
+			RECORD,		// inside a record, node in the tree or npos
+			SKIP,
+		};
+
+		struct frame
+		{
+			roles role;
+			bool object;
+			size_t node;
+			bool keep;		// everything below is written
+			bool capture;	// this container is written
+			size_t mark;	// where its key is, to drop it if it ends up empty
+		};
+
+		writer &out;
+		std::vector<std::string> path;
+		std::vector<node> nodes;
+		std::vector<predicate> predicates;
+		bool selecting = false;
+
+		std::vector<frame> stack;
+		bool started = false;
+		bool match = false;			// last key of an OUTER object was on the path
+		size_t child = npos();		// node of the last key in a record
+		bool keyed = false;			// that key was captured
+
+		// Current record
+		std::vector<event> tape;
+		std::string text;
+		std::vector<bool> seen;
+		bool rejected = false;
+
+		size_t nb_records = 0, nb_kept = 0;
+
+		static size_t npos()
+		{
+			return static_cast<size_t>(-1);
+		}
+
+		static std::vector<std::string> split(const std::string &dotted)
+		{
+			std::vector<std::string> ret;
+			size_t start = 0;
+			while(start < dotted.size())
+			{
+				size_t end = dotted.find('.', start);
+				if(end == std::string::npos)
+					end = dotted.size();
+				ret.push_back(dotted.substr(start, end - start));
+				start = end + 1;
+			}
+			return ret;
+		}
+
+		size_t find(size_t parent, const std::string &k) const
+		{
+			for(const auto &c : this->nodes[parent].children)
+			{
+				if(c.first == k)
+					return c.second;
+			}
+			return npos();
+		}
+
+		// Creates the nodes of a field path, returns the last one
+		size_t insert(const std::string &dotted, bool select)
+		{
+			size_t current = 0;
+			if(select)
+				this->nodes[0].projects = true;
+			for(const std::string &k : split(dotted))
+			{
+				size_t next = this->find(current, k);
+				if(next == npos())
+				{
+					next = this->nodes.size();
+					this->nodes[current].children.push_back(std::make_pair(k, next));
+					this->nodes.push_back(node());
+				}
+				current = next;
+				if(select)
+					this->nodes[current].projects = true;
+			}
+			return current;
+		}
+
+		filter_error no_records() const
+		{
+			std::string dotted;
+			for(const std::string &k : this->path)
+				dotted += (dotted.empty() ? "" : ".") + k;
+			return filter_error("No array of records at \"" + dotted + "\"");
+		}
+
+		static int order(long long a, long long b)			{ return a < b ? -1 : a > b; }
+		static int order(long double a, long double b)		{ return a < b ? -1 : a > b; }
+
+		// A value of the record against a predicate, integer also holds booleans
+		static bool test(const predicate &p, kinds kind, long long integer, long double real, const std::string &str)
+		{
+			const int unordered = 2;
+			int o = unordered;
+
+			switch(p.operand.type)
+			{
+			case value::types::NILL:
+				if(kind == kinds::NIL)
+					o = 0;
+				break;
+			case value::types::BOOLEAN:
+				if(kind == kinds::BOOLEAN)
+					o = order(integer, boost::get<long long>(p.operand.variant));
+				break;
+			case value::types::INTEGER:
+				if(kind == kinds::INTEGER)
+					o = order(integer, boost::get<long long>(p.operand.variant));
+				else if(kind == kinds::REAL)
+					o = order(real, static_cast<long double>(boost::get<long long>(p.operand.variant)));
+				break;
+			case value::types::REAL:
+				if(kind == kinds::INTEGER)
+					o = order(static_cast<long double>(integer), boost::get<long double>(p.operand.variant));
+				else if(kind == kinds::REAL)
+					o = order(real, boost::get<long double>(p.operand.variant));
+				break;
+			case value::types::STRING:
+				if(kind == kinds::STRING)
+				{
+					const int c = str.compare(p.operand.to_string());
+					o = c < 0 ? -1 : c > 0;
+				}
+				break;
+			default:
+				break;
+			}
+
+			switch(p.op)
+			{
+			case comparison::EQUAL:			return o == 0;
+			case comparison::NOT_EQUAL:		return o != 0;
+			case comparison::LESS:			return o == -1;
+			case comparison::LESS_EQUAL:	return o == -1 || o == 0;
+			case comparison::GREATER:		return o == 1;
+			case comparison::GREATER_EQUAL:	return o == 1 || o == 0;
+			}
+			return false;
+		}
+
+		void check(size_t n, kinds kind, long long integer, long double real, const std::string &str)
+		{
+			for(size_t i : this->nodes[n].predicates)
+			{
+				this->seen[i] = true;
+				if(!test(this->predicates[i], kind, integer, real, str))
+					this->rejected = true;
+			}
+		}
+
+		// Captures stop once the record is rejected, it won't be written
+		void push(kinds kind, long long integer = 0, long double real = 0)
+		{
+			if(this->rejected)
+				return;
+			event e;
+			e.kind = kind;
+			e.integer = integer;
+			e.real = real;
+			e.offset = e.length = 0;
+			this->tape.push_back(e);
+		}
+
+		void push(kinds kind, const std::string &str)
+		{
+			if(this->rejected)
+				return;
+			this->push(kind);
+			this->tape.back().offset = this->text.size();
+			this->tape.back().length = str.size();
+			this->text += str;
+		}
+
+		void begin_record()
+		{
+			this->tape.clear();
+			this->text.clear();
+			this->seen.assign(this->predicates.size(), false);
+			this->rejected = false;
+
+			frame f = {roles::RECORD, true, 0, !this->selecting || this->nodes[0].selected, true, 0};
+			this->stack.push_back(f);
+			this->push(kinds::BEGIN_OBJECT);
+		}
+
+		void end_record()
+		{
+			this->nb_records++;
+			if(this->rejected)
+				return;
+			for(bool s : this->seen)
+			{
+				if(!s)
+					return;
+			}
+
+			this->nb_kept++;
+			for(const event &e : this->tape)
+			{
+				switch(e.kind)
+				{
+				case kinds::BEGIN_OBJECT:	this->out.begin_object(); break;
+				case kinds::END_OBJECT:		this->out.end_object(); break;
+				case kinds::BEGIN_ARRAY:	this->out.begin_array(); break;
+				case kinds::END_ARRAY:		this->out.end_array(); break;
+				case kinds::KEY:			this->out.key(this->text.data() + e.offset, e.length); break;
+				case kinds::NIL:			this->out.null(); break;
+				case kinds::BOOLEAN:		this->out.value(e.integer != 0); break;
+				case kinds::INTEGER:		this->out.value(e.integer); break;
+				case kinds::REAL:			this->out.value(e.real); break;
+				case kinds::STRING:			this->out.value(this->text.data() + e.offset, e.length); break;
+				}
+			}
+		}
+
+		// Drops the key of a value that isn't written
+		void unkey()
+		{
+			if(this->keyed && !this->rejected)
+				this->tape.pop_back();
+			this->keyed = false;
+		}
+
+		void open(bool object)
+		{
+			if(this->stack.empty())
+			{
+				if(!this->started)
+				{
+					this->out.begin_array();
+					this->started = true;
+				}
+				if(object == this->path.empty())
+					throw this->no_records();
+				frame f = {this->path.empty() ? roles::RECORDS : roles::OUTER, object, 0, false, false, 0};
+				this->stack.push_back(f);
+				return;
+			}
+
+			const frame parent = this->stack.back();
+			frame f = {roles::SKIP, object, npos(), false, false, 0};
+			switch(parent.role)
+			{
+			case roles::OUTER:
+				if(this->match)
+				{
+					this->match = false;
+					if(parent.node + 1 == this->path.size())
+					{
+						if(object)
+							throw this->no_records();
+						f.role = roles::RECORDS;
+					}
+					else
+					{
+						if(!object)
+							throw this->no_records();
+						f.role = roles::OUTER;
+						f.node = parent.node + 1;
+					}
+				}
+				break;
+
+			case roles::RECORDS:
+				if(!object)
+					throw filter_error("Record isn't an object");
+				return this->begin_record();
+
+			case roles::SKIP:
+				break;
+
+			case roles::RECORD:
+			{
+				const size_t n = parent.object ? this->child : npos();
+				this->child = npos();
+				if(n != npos())
+					this->check(n, object ? kinds::BEGIN_OBJECT : kinds::BEGIN_ARRAY, 0, 0, std::string());
+
+				f.keep = parent.keep || (n != npos() && this->nodes[n].selected);
+				f.capture = f.keep || (object && n != npos() && this->nodes[n].projects);
+				if(!f.capture)
+					this->unkey();
+				if(f.keep || (object && n != npos()))
+				{
+					f.role = roles::RECORD;
+					f.node = object ? n : npos();
+					f.mark = this->keyed ? this->tape.size() - 1 : this->tape.size();
+				}
+				this->keyed = false;
+				if(f.capture)
+					this->push(object ? kinds::BEGIN_OBJECT : kinds::BEGIN_ARRAY);
+				break;
+			}
+			}
+			this->stack.push_back(f);
+		}
+
+		void close()
+		{
+			const frame f = this->stack.back();
+			this->stack.pop_back();
+
+			if(f.role == roles::RECORD && f.capture)
+			{
+				// Objects on the way to selected fields that weren't there
+				if(!f.keep && !this->rejected && this->stack.back().role == roles::RECORD && this->tape.size() == f.mark + 2)
+					this->tape.resize(f.mark);
+				else
+					this->push(f.object ? kinds::END_OBJECT : kinds::END_ARRAY);
+
+				if(this->stack.back().role == roles::RECORDS)
+					this->end_record();
+			}
+
+			if(this->stack.empty())
+				this->out.end_array();
+		}
+
+		void scalar(kinds kind, long long integer, long double real, const std::string &str)
+		{
+			if(this->stack.empty())
+				throw this->no_records();
+
+			const frame &parent = this->stack.back();
+			switch(parent.role)
+			{
+			case roles::OUTER:
+				if(this->match)
+					throw this->no_records();
+				return;
+
+			case roles::RECORDS:
+				throw filter_error("Record isn't an object");
+
+			case roles::SKIP:
+				return;
+
+			case roles::RECORD:
+				break;
+			}
+
+			const size_t n = parent.object ? this->child : npos();
+			this->child = npos();
+			if(n != npos())
+				this->check(n, kind, integer, real, str);
+
+			if(!parent.keep && (n == npos() || !this->nodes[n].selected))
+				return this->unkey();
+			this->keyed = false;
+			if(kind == kinds::STRING)
+				this->push(kind, str);
+			else
+				this->push(kind, integer, real);
+		}
+
+	public:
+		// records is the dotted path of the array of records, empty for the root
+		filter(writer &_out, const std::string &records = std::string()) : out(_out), path(split(records)), nodes(1) {}
+
+		filter(const filter&) = delete;
+		filter& operator=(const filter&) = delete;
+
+		// Keeps the field (and what's below), without any select() records
+		// are kept whole
+		filter& select(const std::string &field)
+		{
+			this->nodes[this->insert(field, true)].selected = true;
+			this->selecting = true;
+			return *this;
+		}
+
+		// Keeps records whose field compares to operand, a scalar; predicates
+		// are all required
+		filter& where(const std::string &field, comparison op, const json::value &operand)
+		{
+			switch(operand.type)
+			{
+			case value::types::NILL:
+			case value::types::BOOLEAN:
+			case value::types::INTEGER:
+			case value::types::REAL:
+			case value::types::STRING:
+				break;
+			default:
+				throw filter_error("Predicates compare scalars");
+			}
+
+			if(field.empty())
+				throw filter_error("Predicates need a field");
+
+			const size_t n = this->insert(field, false);
+			this->nodes[n].predicates.push_back(this->predicates.size());
+			predicate p = {op, operand};
+			this->predicates.push_back(p);
+			return *this;
+		}
+
+		void run(std::istream &stream)
+		{
+			parser(stream).parse(*this);
+		}
+
+		size_t records() const
+		{
+			return this->nb_records;
+		}
+
+		size_t kept() const
+		{
+			return this->nb_kept;
+		}
+
+		void begin_object()		{ this->open(true); }
+		void end_object()		{ this->close(); }
+		void begin_array()		{ this->open(false); }
+		void end_array()		{ this->close(); }
+
+		void key(const std::string &k)
+		{
+			const frame &f = this->stack.back();
+			if(f.role == roles::OUTER)
+			{
+				this->match = k == this->path[f.node];
+				return;
+			}
+			if(f.role != roles::RECORD)
+				return;
+
+			this->child = f.node == npos() ? npos() : this->find(f.node, k);
+			this->keyed = f.keep || (this->child != npos() && this->nodes[this->child].projects);
+			if(this->keyed)
+				this->push(kinds::KEY, k);
+		}
+
+		void null()							{ this->scalar(kinds::NIL, 0, 0, std::string()); }
+		void boolean(bool v)				{ this->scalar(kinds::BOOLEAN, v, 0, std::string()); }
+		void integer(long long v)			{ this->scalar(kinds::INTEGER, v, 0, std::string()); }
+		void real(long double v)			{ this->scalar(kinds::REAL, 0, v, std::string()); }
+		void string(const std::string &v)	{ this->scalar(kinds::STRING, 0, 0, v); }
+	};
+} //namespace json
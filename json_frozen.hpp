@@ -0,0 +1,570 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json.hpp"
+
+namespace json
+{
+	class frozen_error : public std::runtime_error
+	{
+	public:
+		frozen_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	// Read-only document in a single block without pointers: nodes refer to
+	// each other by offset, so the block can be shared by any number of
+	// threads without locking, written to disk and mapped back as is.
+	//
+	// Layout, native endianness, everything 8 bytes aligned:
+	//   header, then nodes, arrays of nodes, member arrays and strings.
+	//   Object keys are stored once in a sorted table, members refer to them by
+	//   index and are sorted by it, which is also their string order.
+	//   Reals are stored as double.
+	class frozen
+	{
+	private:
+		struct header
+		{
+			char magic[8];
+			uint32_t endian;
+			uint32_t length;	// of the whole block
+			uint32_t root;		// offset of the root node
+			uint32_t keys;		// offset of the key table
+			uint32_t nb_keys;
+			uint32_t padding;
+		};
+
+		struct node
+		{
+			uint32_t type;		// value::types
+			uint32_t size;		// string length, array or object size
+			uint64_t data;		// scalar bits or offset of the content
+		};
+
+		struct member
+		{
+			uint32_t key;
+			uint32_t padding;
+			node val;
+		};
+
+		struct key_entry
+		{
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		static const char* magic()
+		{
+			return "jsfrozn1";
+		}
+
+		static uint32_t endian()
+		{
+			return 0x01020304;
+		}
+
+		std::shared_ptr<const void> storage;
+		const char *base = nullptr;
+
+		template<typename tStruct>
+		static const tStruct& at(const char *base, uint64_t offset)
+		{
+			return *reinterpret_cast<const tStruct*>(base + offset);
+		}
+
+		template<typename tStruct>
+		const tStruct& at(uint64_t offset) const
+		{
+			return at<tStruct>(this->base, offset);
+		}
+
+		static const key_entry& key_at(const char *base, uint32_t index)
+		{
+			return at<key_entry>(base, at<header>(base, 0).keys + index * sizeof(key_entry));
+		}
+
+		const header& head() const
+		{
+			return this->at<header>(0);
+		}
+
+		// Builds the block, see freeze()
+		class builder
+		{
+		private:
+			std::vector<uint64_t> words;	// 8 bytes aligned storage
+			size_t used = 0;
+			std::map<std::string, uint32_t> keys;
+
+			char* data()
+			{
+				return reinterpret_cast<char*>(this->words.data());
+			}
+
+			size_t alloc(size_t bytes)
+			{
+				const size_t ret = this->used;
+				this->used += (bytes + 7) & ~static_cast<size_t>(7);
+				if(this->used > UINT32_MAX)
+					throw frozen_error("Document too large to freeze");
+				if(this->used / 8 > this->words.size())
+					this->words.resize(std::max(this->used / 8, this->words.size() * 2), 0);
+				return ret;
+			}
+
+			void collect(const value &v)
+			{
+				if(v.type == value::types::ARRAY)
+				{
+					for(const value &e : boost::get<array>(v.variant))
+						this->collect(e);
+				}
+				else if(v.type == value::types::OBJECT)
+				{
+					for(const auto &m : boost::get<object>(v.variant))
+					{
+						this->keys[m.first];
+						this->collect(m.second);
+					}
+				}
+			}
+
+			size_t string(const std::string &s)
+			{
+				const size_t ret = this->alloc(s.size() + 1);
+				std::memcpy(this->data() + ret, s.data(), s.size());
+				return ret;
+			}
+
+			// Fills the node at offset, offsets only as words moves while growing
+			void fill(size_t offset, const value &v)
+			{
+				node n = {static_cast<uint32_t>(v.type), 0, 0};
+				switch(v.type)
+				{
+				case value::types::NONE:
+				case value::types::NILL:
+					break;
+				case value::types::BOOLEAN:
+				case value::types::INTEGER:
+					n.data = static_cast<uint64_t>(boost::get<long long>(v.variant));
+					break;
+				case value::types::REAL:
+				{
+					const double d = static_cast<double>(boost::get<long double>(v.variant));
+					std::memcpy(&n.data, &d, sizeof(d));
+					break;
+				}
+				case value::types::STRING:
+				{
+					const std::string &s = v.to_string();
+					n.size = s.size();
+					n.data = this->string(s);
+					break;
+				}
+				case value::types::ARRAY:
+				{
+					const array &arr = boost::get<array>(v.variant);
+					n.size = arr.size();
+					n.data = this->alloc(arr.size() * sizeof(node));
+					for(size_t i = 0; i < arr.size(); i++)
+						this->fill(n.data + i * sizeof(node), arr[i]);
+					break;
+				}
+				case value::types::OBJECT:
+				{
+					const object &obj = boost::get<object>(v.variant);
+					n.size = obj.size();
+					n.data = this->alloc(obj.size() * sizeof(member));
+					size_t i = 0;
+					for(const auto &m : obj)
+					{
+						const size_t slot = n.data + i++ * sizeof(member);
+						const member entry = {this->keys[m.first], 0, node()};
+						std::memcpy(this->data() + slot, &entry, sizeof(entry));
+						this->fill(slot + offsetof(member, val), m.second);
+					}
+					break;
+				}
+				}
+				std::memcpy(this->data() + offset, &n, sizeof(n));
+			}
+
+		public:
+			frozen build(const value &root)
+			{
+				this->collect(root);
+
+				const size_t head = this->alloc(sizeof(header));
+				const size_t table = this->alloc(this->keys.size() * sizeof(key_entry));
+
+				// Indexes in string order, members sorted by key are sorted by index
+				uint32_t index = 0;
+				for(auto &k : this->keys)
+				{
+					k.second = index;
+					const key_entry entry = {static_cast<uint32_t>(this->string(k.first)), static_cast<uint32_t>(k.first.size())};
+					std::memcpy(this->data() + table + index++ * sizeof(key_entry), &entry, sizeof(entry));
+				}
+
+				const size_t root_node = this->alloc(sizeof(node));
+				this->fill(root_node, root);
+
+				header h;
+				std::memcpy(h.magic, magic(), sizeof(h.magic));
+				h.endian = endian();
+				h.length = this->used;
+				h.root = root_node;
+				h.keys = table;
+				h.nb_keys = this->keys.size();
+				h.padding = 0;
+				std::memcpy(this->data() + head, &h, sizeof(h));
+
+				this->words.resize(this->used / 8);
+				auto block = std::make_shared<std::vector<uint64_t>>(std::move(this->words));
+				return frozen(std::shared_ptr<const void>(block, block->data()));
+			}
+		};
+
+		void check_range(uint64_t offset, uint64_t size) const
+		{
+			if(offset % 8 != 0 || offset > this->head().length || size > this->head().length - offset)
+				throw frozen_error("Corrupted frozen document");
+		}
+
+		void check_string(uint64_t offset, uint32_t length) const
+		{
+			this->check_range(offset, static_cast<uint64_t>(length) + 1);
+			if(this->base[offset + length] != '\0')
+				throw frozen_error("Corrupted frozen document");
+		}
+
+		// Bounds of every offset, once on load so accessors don't need to
+		void check(const node &n, size_t depth) const
+		{
+			if(depth > 10000)
+				throw frozen_error("Frozen document too deep");
+
+			switch(static_cast<value::types>(n.type))
+			{
+			case value::types::NONE:
+			case value::types::NILL:
+			case value::types::BOOLEAN:
+			case value::types::INTEGER:
+			case value::types::REAL:
+				break;
+			case value::types::STRING:
+				this->check_string(n.data, n.size);
+				break;
+			case value::types::ARRAY:
+				this->check_range(n.data, static_cast<uint64_t>(n.size) * sizeof(node));
+				for(uint32_t i = 0; i < n.size; i++)
+					this->check(this->at<node>(n.data + i * sizeof(node)), depth + 1);
+				break;
+			case value::types::OBJECT:
+				this->check_range(n.data, static_cast<uint64_t>(n.size) * sizeof(member));
+				for(uint32_t i = 0; i < n.size; i++)
+				{
+					const member &m = this->at<member>(n.data + i * sizeof(member));
+					if(m.key >= this->head().nb_keys || (i > 0 && this->at<member>(n.data + (i - 1) * sizeof(member)).key >= m.key))
+						throw frozen_error("Corrupted frozen document");
+					this->check(m.val, depth + 1);
+				}
+				break;
+			default:
+				throw frozen_error("Corrupted frozen document");
+			}
+		}
+
+		void check() const
+		{
+			if(this->head().length < sizeof(header) || std::memcmp(this->head().magic, magic(), sizeof(header().magic)) != 0)
+				throw frozen_error("Not a frozen document");
+			if(this->head().endian != endian())
+				throw frozen_error("Frozen document of another byte order");
+
+			this->check_range(this->head().keys, static_cast<uint64_t>(this->head().nb_keys) * sizeof(key_entry));
+			for(uint32_t i = 0; i < this->head().nb_keys; i++)
+			{
+				const key_entry &k = this->at<key_entry>(this->head().keys + i * sizeof(key_entry));
+				this->check_string(k.offset, k.length);
+			}
+			this->check_range(this->head().root, sizeof(node));
+			this->check(this->at<node>(this->head().root), 0);
+		}
+
+		frozen(const std::shared_ptr<const void> &_storage)
+			: storage(_storage), base(static_cast<const char*>(_storage.get())) {}
+
+		friend frozen freeze(const value &v);
+
+	public:
+		// Light handle on a node, valid as long as a frozen sharing the block lives
+		class view
+		{
+		private:
+			const char *base;
+			const node *n;
+
+			friend class frozen;
+
+			view(const char *_base, const node *_n) : base(_base), n(_n) {}
+
+			const member& entry(size_t i) const
+			{
+				assert(this->is_object() && i < this->n->size);
+				return at<member>(this->base, this->n->data + i * sizeof(member));
+			}
+
+			int compare_key(size_t i, const std::string &k) const
+			{
+				const key_entry &e = key_at(this->base, this->entry(i).key);
+				const int ret = std::memcmp(this->base + e.offset, k.data(), std::min<size_t>(e.length, k.size()));
+				if(ret != 0)
+					return ret;
+				return e.length < k.size() ? -1 : (e.length > k.size() ? 1 : 0);
+			}
+
+		public:
+			json::value::types type() const	{ return static_cast<json::value::types>(this->n->type); }
+
+			bool is_null() const	{ return this->type() == json::value::types::NILL; }
+			bool is_bool() const	{ return this->type() == json::value::types::BOOLEAN; }
+			bool is_integer() const	{ return this->type() == json::value::types::INTEGER; }
+			bool is_real() const	{ return this->type() == json::value::types::REAL; }
+			bool is_number() const	{ return this->is_integer() || this->is_real(); }
+			bool is_string() const	{ return this->type() == json::value::types::STRING; }
+			bool is_array() const	{ return this->type() == json::value::types::ARRAY; }
+			bool is_object() const	{ return this->type() == json::value::types::OBJECT; }
+
+			bool to_bool() const
+			{
+				assert(this->is_bool());
+				return this->n->data != 0;
+			}
+
+			long long to_integer() const
+			{
+				assert(this->is_integer());
+				return static_cast<long long>(this->n->data);
+			}
+
+			double to_real() const
+			{
+				assert(this->is_real());
+				double ret;
+				std::memcpy(&ret, &this->n->data, sizeof(ret));
+				return ret;
+			}
+
+			// NUL terminated, length() bytes long
+			const char* c_str() const
+			{
+				assert(this->is_string());
+				return this->base + this->n->data;
+			}
+
+			size_t length() const
+			{
+				assert(this->is_string());
+				return this->n->size;
+			}
+
+			std::string to_string() const
+			{
+				return std::string(this->c_str(), this->length());
+			}
+
+			size_t size() const
+			{
+				return this->is_array() || this->is_object() ? this->n->size : 1;
+			}
+
+			view get(size_t i) const
+			{
+				assert(this->is_array());
+				if(i >= this->n->size)
+					throw std::out_of_range("Frozen array index out of range");
+				return view(this->base, &at<node>(this->base, this->n->data + i * sizeof(node)));
+			}
+
+			// Name and value of the i-th member, in key order
+			std::string key(size_t i) const
+			{
+				const key_entry &e = key_at(this->base, this->entry(i).key);
+				return std::string(this->base + e.offset, e.length);
+			}
+
+			view value(size_t i) const
+			{
+				return view(this->base, &this->entry(i).val);
+			}
+
+			bool find(const std::string &k, view &out) const
+			{
+				assert(this->is_object());
+				size_t low = 0, high = this->n->size;
+				while(low < high)
+				{
+					const size_t mid = (low + high) / 2;
+					const int cmp = this->compare_key(mid, k);
+					if(cmp == 0)
+					{
+						out = this->value(mid);
+						return true;
+					}
+					if(cmp < 0)
+						low = mid + 1;
+					else
+						high = mid;
+				}
+				return false;
+			}
+
+			view get(const std::string &k) const
+			{
+				view ret(*this);
+				if(!this->find(k, ret))
+					throw std::out_of_range("No such member: " + k);
+				return ret;
+			}
+
+			template<size_t N>
+			view get(const char (&k)[N]) const
+			{
+				return this->get(std::string(k));
+			}
+
+			// Back to a mutable tree
+			json::value thaw() const
+			{
+				switch(this->type())
+				{
+				case json::value::types::NONE:
+				{
+					json::value ret;
+					ret.type = json::value::types::NONE;
+					return ret;
+				}
+				case json::value::types::NILL:	return json::value();
+				case json::value::types::BOOLEAN:	return this->to_bool();
+				case json::value::types::INTEGER:	return this->to_integer();
+				case json::value::types::REAL:	return this->to_real();
+				case json::value::types::STRING:	return this->to_string();
+				case json::value::types::ARRAY:
+				{
+					json::value ret = array();
+					array &arr = ret.to_array();
+					arr.reserve(this->size());
+					for(size_t i = 0; i < this->size(); i++)
+						arr.push_back(this->get(i).thaw());
+					return ret;
+				}
+				case json::value::types::OBJECT:
+				{
+					json::value ret = object();
+					object &obj = ret.to_object();
+					for(size_t i = 0; i < this->size(); i++)
+						obj.insert(obj.end(), std::make_pair(json::key(this->key(i)), this->value(i).thaw()));
+					return ret;
+				}
+				}
+
+				// unreachable
+				return json::value();
+			}
+		};
+
+		frozen() {}
+
+		view root() const
+		{
+			assert(this->base != nullptr);
+			return view(this->base, &this->at<node>(this->head().root));
+		}
+
+		size_t size() const
+		{
+			return this->base == nullptr ? 0 : this->head().length;
+		}
+
+		void save(std::ostream &stream) const
+		{
+			stream.write(this->base, this->size());
+		}
+
+		static frozen read(std::istream &stream)
+		{
+			header h;
+			if(!stream.read(reinterpret_cast<char*>(&h), sizeof(h)) || std::memcmp(h.magic, magic(), sizeof(h.magic)) != 0)
+				throw frozen_error("Not a frozen document");
+			if(h.length < sizeof(header) || h.length % 8 != 0)
+				throw frozen_error("Corrupted frozen document");
+
+			auto block = std::make_shared<std::vector<uint64_t>>(h.length / 8);
+			std::memcpy(block->data(), &h, sizeof(h));
+			if(!stream.read(reinterpret_cast<char*>(block->data()) + sizeof(h), h.length - sizeof(h)))
+				throw frozen_error("Truncated frozen document");
+
+			frozen ret(std::shared_ptr<const void>(block, block->data()));
+			ret.check();
+			return ret;
+		}
+
+		// Maps the file read-only, pages are shared with every process mapping it
+		static frozen load(const std::string &path)
+		{
+			const int fd = open(path.c_str(), O_RDONLY);
+			if(fd < 0)
+				throw std::system_error(errno, std::generic_category(), "Can't open " + path);
+
+			struct stat st;
+			if(fstat(fd, &st) != 0)
+			{
+				const int err = errno;
+				close(fd);
+				throw std::system_error(err, std::generic_category(), "Can't stat " + path);
+			}
+			if(static_cast<size_t>(st.st_size) < sizeof(header))
+			{
+				close(fd);
+				throw frozen_error("Not a frozen document");
+			}
+
+			const size_t length = st.st_size;
+			void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+			const int err = errno;
+			close(fd);
+			if(mapping == MAP_FAILED)
+				throw std::system_error(err, std::generic_category(), "Can't map " + path);
+
+			frozen ret(std::shared_ptr<const void>(mapping, [length](const void *p) { munmap(const_cast<void*>(p), length); }));
+			if(ret.head().length != length)
+				throw frozen_error("Corrupted frozen document");
+			ret.check();
+			return ret;
+		}
+	};
+
+	// Copies v into a frozen block, v can be modified or dropped afterwards
+	inline frozen freeze(const value &v)
+	{
+		return frozen::builder().build(v);
+	}
+} //namespace json
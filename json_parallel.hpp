@@ -0,0 +1,316 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <streambuf>
+#include <iterator>
+#include <algorithm>
+
+#include "json.hpp"
+
+namespace json
+{
+	// Parses the root array or object of a single document on several threads.
+	// A pre-scan splits the root at top-level commas, each slice is parsed by a
+	// regular parser and the results are stitched back in document order, so the
+	// value is the same as parser::parse() would return.
+	class parallel_parser
+	{
+	private:
+		class membuf : public std::streambuf
+		{
+		public:
+			membuf(const char *begin, const char *end)
+			{
+				this->setg(const_cast<char*>(begin), const_cast<char*>(begin), const_cast<char*>(end));
+			}
+		};
+
+		struct slice
+		{
+			size_t begin, end;
+			value result;
+			bool failed = false;
+			int row = 0, col = 0;
+			std::string message;
+			std::exception_ptr exception;
+			VITRINE_INSTRUMENT_ONLY(instrument::counters stats;)
+		};
+
+		std::vector<char> buffer;
+		const char *data;
+		size_t length;
+		unsigned threads;
+
+		// Slices smaller than this aren't worth a thread hop
+		enum { min_slice = 64 * 1024 };
+
+		static bool is_space(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+		}
+
+		std::tuple<int, int> position(size_t offset) const
+		{
+			int row = 1, col = 1;
+			for(size_t i = 0; i < offset; i++)
+			{
+				if(this->data[i] == '\n')
+				{
+					row++;
+					col = 1;
+				}
+				else
+					col++;
+			}
+			return std::tuple<int, int>(row, col);
+		}
+
+		void error(size_t offset, const char *mess) const
+		{
+			auto pos = this->position(offset);
+			throw parser::parsing_error(std::get<0>(pos), std::get<1>(pos), mess);
+		}
+
+		// Returns the offset of the character closing the root, and fills the
+		// offsets of every top-level separator in between.
+		size_t scan(size_t root, std::vector<size_t> &commas) const
+		{
+			int depth = 0;
+			bool in_string = false;
+
+			for(size_t i = root; i < this->length; i++)
+			{
+				const char c = this->data[i];
+
+				if(in_string)
+				{
+					if(c == '\\')
+						i++;
+					else if(c == '"')
+						in_string = false;
+					continue;
+				}
+
+				switch(c)
+				{
+				case '"':
+					in_string = true;
+					break;
+				case '{':
+				case '[':
+					depth++;
+					break;
+				case '}':
+				case ']':
+					if(--depth == 0)
+						return i;
+					break;
+				case ',':
+					if(depth == 1)
+						commas.push_back(i);
+					break;
+				}
+			}
+
+			this->error(this->length, "Unexpected end of stream");
+			return this->length;
+		}
+
+		std::vector<slice> split(size_t begin, size_t end, const std::vector<size_t> &commas) const
+		{
+			const size_t wanted = this->threads * 8;
+			const size_t target = std::max<size_t>(min_slice, (end - begin) / wanted);
+
+			std::vector<slice> slices;
+			size_t start = begin;
+			for(size_t comma : commas)
+			{
+				if(comma - start >= target)
+				{
+					slices.push_back(slice());
+					slices.back().begin = start;
+					slices.back().end = comma;
+					start = comma + 1;
+				}
+			}
+			slices.push_back(slice());
+			slices.back().begin = start;
+			slices.back().end = end;
+
+			return slices;
+		}
+
+		void parse_slice(slice &s, bool members, bool last)
+		{
+			// A slice can't be empty nor end on a separator unless it's the
+			// last one: that would be a doubled comma, rejected by the serial parser
+			if(!last)
+			{
+				size_t e = s.end;
+				while(e > s.begin && is_space(this->data[e - 1]))
+					e--;
+				if(e == s.begin || this->data[e - 1] == ',')
+				{
+					auto pos = this->position(s.end);
+					s.failed = true;
+					s.row = std::get<0>(pos);
+					s.col = std::get<1>(pos);
+					s.message = "Unexpected character";
+					return;
+				}
+			}
+
+			membuf buf(this->data + s.begin, this->data + s.end);
+			std::istream stream(&buf);
+			parser p(stream);
+
+			try
+			{
+				if(members)
+				{
+					s.result = object();
+					p.parse_members(s.result.to_object(), std::char_traits<char>::eof());
+				}
+				else
+				{
+					s.result = array();
+					p.parse_elements(s.result.to_array(), std::char_traits<char>::eof());
+				}
+				// Slices are parts of one parse, reported together by parse()
+				VITRINE_INSTRUMENT_ONLY(s.stats = p.stats;)
+			}
+			catch(parser::parsing_error &e)
+			{
+				// Positions are relative to the slice, rebase them on the document
+				auto base = this->position(s.begin);
+				auto pos = e.get_pos();
+				s.failed = true;
+				s.row = std::get<0>(pos) + std::get<0>(base) - 1;
+				s.col = std::get<0>(pos) == 1 ? std::get<1>(pos) + std::get<1>(base) - 1 : std::get<1>(pos);
+				s.message = e.what();
+			}
+			catch(...)
+			{
+				s.failed = true;
+				s.exception = std::current_exception();
+			}
+		}
+
+	public:
+		parallel_parser(std::istream &stream, unsigned _threads = std::thread::hardware_concurrency())
+			: threads(std::max(1u, _threads))
+		{
+			const size_t block = 1 << 20;
+			while(stream.good())
+			{
+				size_t size = this->buffer.size();
+				this->buffer.resize(size + block);
+				stream.read(&this->buffer[size], block);
+				this->buffer.resize(size + stream.gcount());
+			}
+			this->data = this->buffer.data();
+			this->length = this->buffer.size();
+		}
+
+		// The caller keeps ownership of data, which must outlive the parse
+		parallel_parser(const char *_data, size_t _length, unsigned _threads = std::thread::hardware_concurrency())
+			: data(_data), length(_length), threads(std::max(1u, _threads))
+		{
+		}
+
+		value parse()
+		{
+			VITRINE_INSTRUMENT_ONLY(const auto start = std::chrono::steady_clock::now();)
+			size_t root = 0;
+			while(root < this->length && is_space(this->data[root]))
+				root++;
+
+			if(root == this->length || (this->data[root] != '{' && this->data[root] != '['))
+				this->error(root, "JSON Root neither an object nor an array");
+			const bool members = this->data[root] == '{';
+
+			std::vector<size_t> commas;
+			const size_t close = this->scan(root, commas);
+			if(this->data[close] != (members ? '}' : ']'))
+				this->error(close, "Unexpected character");
+
+			std::vector<slice> slices = this->split(root + 1, close, commas);
+
+			std::atomic<size_t> next(0);
+			auto worker = [&]()
+			{
+				for(size_t i = next++; i < slices.size(); i = next++)
+					this->parse_slice(slices[i], members, i + 1 == slices.size());
+			};
+
+			const size_t count = std::min<size_t>(this->threads, slices.size());
+			std::vector<std::thread> pool;
+			for(size_t i = 1; i < count; i++)
+				pool.push_back(std::thread(worker));
+			worker();
+			for(std::thread &t : pool)
+				t.join();
+
+			// Report the first error in document order, like the serial parser
+			for(slice &s : slices)
+			{
+				if(!s.failed)
+					continue;
+				if(s.exception)
+					std::rethrow_exception(s.exception);
+				throw parser::parsing_error(s.row, s.col, s.message.c_str());
+			}
+
+			value ret = std::move(slices.front().result);
+			if(members)
+			{
+				object &obj = ret.to_object();
+				for(size_t i = 1; i < slices.size(); i++)
+				{
+					object &part = slices[i].result.to_object();
+					for(auto it = part.begin(); it != part.end(); it++)
+						obj.insert(std::move(*it));
+				}
+			}
+			else
+			{
+				array &arr = ret.to_array();
+				size_t total = arr.size();
+				for(size_t i = 1; i < slices.size(); i++)
+					total += slices[i].result.to_array().size();
+				arr.reserve(total);
+
+				for(size_t i = 1; i < slices.size(); i++)
+				{
+					array &part = slices[i].result.to_array();
+					std::move(part.begin(), part.end(), std::back_inserter(arr));
+				}
+			}
+
+			VITRINE_INSTRUMENT_ONLY(
+				// Counted like the serial parser would: one parse, the root
+				// container around the slices, and the bytes up to its end.
+				// Each slice allocated a container of its own.
+				instrument::counters stats;
+				for(slice &s : slices)
+					stats += s.stats;
+				stats.parses = 1;
+				stats.parsed_bytes = close + 1;
+				stats.values[static_cast<size_t>(members ? value::types::OBJECT : value::types::ARRAY)]++;
+				stats.allocations += slices.size();
+				stats.max_depth++;
+				stats.nanoseconds[instrument::PARSE] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count();
+				instrument::record_parse(stats);
+			)
+			return ret;
+		}
+	};
+} //namespace json
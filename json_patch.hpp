@@ -0,0 +1,459 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+
+#include "json.hpp"
+#include "json_pointer.hpp"
+
+namespace json
+{
+	class patch_error : public std::runtime_error
+	{
+	public:
+		patch_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	namespace pointer
+	{
+		inline std::vector<std::string> split(const std::string &path)
+		{
+			std::vector<std::string> ret;
+			if(path.empty())
+				return ret;
+			if(path[0] != '/')
+				throw patch_error("Invalid JSON pointer: " + path);
+
+			for(size_t i = 0; i < path.size(); i++)
+			{
+				if(path[i] == '/')
+				{
+					ret.push_back(std::string());
+					continue;
+				}
+				if(path[i] == '~')
+				{
+					if(i + 1 < path.size() && path[i + 1] == '0')
+						ret.back() += '~';
+					else if(i + 1 < path.size() && path[i + 1] == '1')
+						ret.back() += '/';
+					else
+						throw patch_error("Invalid JSON pointer escape: " + path);
+					i++;
+					continue;
+				}
+				ret.back() += path[i];
+			}
+			return ret;
+		}
+	} // namespace pointer
+
+	// Subtrees whose digests match aren't walked, and digests of the containers
+	// a copy shares with its original are kept in the cache: diffing successive
+	// versions of a document through the same cache costs in the size of the
+	// change, not of the document.
+	class differ
+	{
+	private:
+		value ops;
+		hash_cache own;
+		hash_cache *hashes;
+
+		// Above this many cells, arrays are aligned by position instead of LCS
+		enum { lcs_limit = 1 << 22 };
+
+		void op(const char *name, const std::string &path)
+		{
+			value o = object();
+			o.add("op", name);
+			o.add("path", path);
+			this->ops.add(o);
+		}
+
+		void op(const char *name, const std::string &path, const value &val)
+		{
+			value o = object();
+			o.add("op", name);
+			o.add("path", path);
+			o.add("value", val);
+			this->ops.add(o);
+		}
+
+		void diff_object(const std::string &path, const object &from, const object &to)
+		{
+			// Both maps are sorted by key, walk them side by side
+			auto a = from.cbegin();
+			auto b = to.cbegin();
+			while(a != from.cend() || b != to.cend())
+			{
+				if(b == to.cend() || (a != from.cend() && a->first < b->first))
+				{
+					this->op("remove", path + "/" + pointer::escape(a->first));
+					a++;
+				}
+				else if(a == from.cend() || b->first < a->first)
+				{
+					this->op("add", path + "/" + pointer::escape(b->first), b->second);
+					b++;
+				}
+				else
+				{
+					this->diff(path + "/" + pointer::escape(a->first), a->second, b->second);
+					a++;
+					b++;
+				}
+			}
+		}
+
+		static bool is_container(const value &v)
+		{
+			return v.type == value::types::ARRAY || v.type == value::types::OBJECT;
+		}
+
+		// Containers by digest, scalars directly
+		bool same(const value &a, const value &b)
+		{
+			if(is_container(a) && is_container(b))
+				return this->hashes->hash(a) == this->hashes->hash(b);
+			return !is_container(a) && !is_container(b) && a == b;
+		}
+
+		void diff_array(const std::string &path, const array &from, const array &to)
+		{
+			// Common ends are skipped, stopping at the first difference
+			size_t head = 0;
+			while(head < from.size() && head < to.size() && this->same(from[head], to[head]))
+				head++;
+
+			size_t tail = 0;
+			while(tail < from.size() - head && tail < to.size() - head
+				&& this->same(from[from.size() - 1 - tail], to[to.size() - 1 - tail]))
+				tail++;
+
+			const size_t n = from.size() - head - tail;
+			const size_t m = to.size() - head - tail;
+
+			// Elements in between are aligned by their exact digests
+			std::vector<value::digest> hfrom, hto;
+			hfrom.reserve(n);
+			for(size_t i = 0; i < n; i++)
+				hfrom.push_back(this->hashes->hash(from[head + i]));
+			hto.reserve(m);
+			for(size_t j = 0; j < m; j++)
+				hto.push_back(this->hashes->hash(to[head + j]));
+
+			auto match = [&](size_t i, size_t j) { return hfrom[i] == hto[j]; };
+
+			// Alignment of the middle parts, as (from, to) pairs of matching elements
+			std::vector<std::pair<size_t, size_t>> matches;
+			if(n > 0 && m > 0 && n * m <= lcs_limit)
+			{
+				std::vector<uint32_t> lcs((n + 1) * (m + 1), 0);
+				for(size_t i = n; i-- > 0;)
+				{
+					for(size_t j = m; j-- > 0;)
+					{
+						if(match(i, j))
+							lcs[i * (m + 1) + j] = lcs[(i + 1) * (m + 1) + j + 1] + 1;
+						else
+							lcs[i * (m + 1) + j] = std::max(lcs[(i + 1) * (m + 1) + j], lcs[i * (m + 1) + j + 1]);
+					}
+				}
+
+				for(size_t i = 0, j = 0; i < n && j < m;)
+				{
+					if(match(i, j))
+						matches.push_back(std::make_pair(i++, j++));
+					else if(lcs[(i + 1) * (m + 1) + j] >= lcs[i * (m + 1) + j + 1])
+						i++;
+					else
+						j++;
+				}
+			}
+			matches.push_back(std::make_pair(n, m));
+
+			// Index in the array as patched so far
+			size_t index = head;
+			size_t i = 0, j = 0;
+			for(const auto &match : matches)
+			{
+				// Gap between matches: pair up changed elements, then remove or add the rest
+				while(i < match.first && j < match.second)
+				{
+					this->diff(path + "/" + std::to_string(index), from[head + i], to[head + j]);
+					index++;
+					i++;
+					j++;
+				}
+				for(; i < match.first; i++)
+					this->op("remove", path + "/" + std::to_string(index));
+				for(; j < match.second; j++)
+					this->op("add", path + "/" + std::to_string(index++), to[head + j]);
+
+				// Skip the match itself
+				index++;
+				i++;
+				j++;
+			}
+		}
+
+		void diff(const std::string &path, const value &from, const value &to)
+		{
+			// Subtrees with the same digest are equal and not walked
+			if(is_container(from) && is_container(to) && this->same(from, to))
+				return;
+			if(from.type == value::types::OBJECT && to.type == value::types::OBJECT)
+				this->diff_object(path, boost::get<object>(from.variant), boost::get<object>(to.variant));
+			else if(from.type == value::types::ARRAY && to.type == value::types::ARRAY)
+				this->diff_array(path, boost::get<array>(from.variant), boost::get<array>(to.variant));
+			else if(from != to)
+				this->op("replace", path, to);
+		}
+
+	public:
+		differ() : ops(array()), own(true), hashes(&this->own) {}
+		differ(const differ &) = delete;
+		differ& operator=(const differ &) = delete;
+
+		// Digests are kept in the caller's cache, which must be exact so that
+		// a real turned integer still yields an operation
+		explicit differ(hash_cache &cache) : ops(array()), hashes(&cache)
+		{
+			if(!cache.is_exact())
+				throw std::invalid_argument("Diffs need an exact hash_cache");
+		}
+
+		// Returns the RFC 6902 patch turning from into to
+		value operator()(const value &from, const value &to)
+		{
+			this->ops = array();
+			this->diff("", from, to);
+			return this->ops;
+		}
+	};
+
+	inline value diff(const value &from, const value &to)
+	{
+		return differ()(from, to);
+	}
+
+	inline value diff(const value &from, const value &to, hash_cache &cache)
+	{
+		return differ(cache)(from, to);
+	}
+
+	class patcher
+	{
+	private:
+		value &doc;
+
+		static size_t index(const std::string &token, size_t size, bool append)
+		{
+			if(append && token == "-")
+				return size;
+			if(token.empty() || (token.size() > 1 && token[0] == '0'))
+				throw patch_error("Invalid array index: " + token);
+
+			size_t ret = 0;
+			for(char c : token)
+			{
+				if(c < '0' || c > '9')
+					throw patch_error("Invalid array index: " + token);
+				// Stops before overflowing, anything past size is out of range anyway
+				ret = ret * 10 + (c - '0');
+				if(ret > size)
+					throw patch_error("Array index out of range: " + token);
+			}
+			if(!append && ret == size)
+				throw patch_error("Array index out of range: " + token);
+			return ret;
+		}
+
+		value& resolve(const std::vector<std::string> &tokens, size_t count)
+		{
+			value *cur = &this->doc;
+			for(size_t i = 0; i < count; i++)
+			{
+				if(cur->is_object())
+				{
+					object &obj = cur->to_object();
+					auto it = obj.find(key::ref(tokens[i]));
+					if(it == obj.end())
+						throw patch_error("No such member: " + tokens[i]);
+					cur = &it->second;
+				}
+				else if(cur->is_array())
+					cur = &cur->to_array()[index(tokens[i], cur->size(), false)];
+				else
+					throw patch_error("Can't index a scalar with: " + tokens[i]);
+			}
+			return *cur;
+		}
+
+		value& get(const std::string &path)
+		{
+			const std::vector<std::string> tokens = pointer::split(path);
+			return this->resolve(tokens, tokens.size());
+		}
+
+		void add(const std::string &path, const value &val)
+		{
+			const std::vector<std::string> tokens = pointer::split(path);
+			if(tokens.empty())
+			{
+				this->doc = val;
+				return;
+			}
+
+			value &parent = this->resolve(tokens, tokens.size() - 1);
+			if(parent.is_object())
+			{
+				object &obj = parent.to_object();
+				auto it = obj.find(key::ref(tokens.back()));
+				if(it != obj.end())
+					it->second = val;
+				else
+					obj.insert(std::make_pair(key(tokens.back()), val));
+			}
+			else if(parent.is_array())
+			{
+				array &arr = parent.to_array();
+				arr.insert(arr.begin() + index(tokens.back(), arr.size(), true), val);
+			}
+			else
+				throw patch_error("Can't add to a scalar: " + path);
+		}
+
+		value remove(const std::string &path)
+		{
+			const std::vector<std::string> tokens = pointer::split(path);
+			if(tokens.empty())
+				throw patch_error("Can't remove the root");
+
+			value ret;
+			value &parent = this->resolve(tokens, tokens.size() - 1);
+			if(parent.is_object())
+			{
+				object &obj = parent.to_object();
+				auto it = obj.find(key::ref(tokens.back()));
+				if(it == obj.end())
+					throw patch_error("No such member: " + path);
+				ret = std::move(it->second);
+				obj.erase(it);
+			}
+			else if(parent.is_array())
+			{
+				array &arr = parent.to_array();
+				auto it = arr.begin() + index(tokens.back(), arr.size(), false);
+				ret = std::move(*it);
+				arr.erase(it);
+			}
+			else
+				throw patch_error("Can't remove from a scalar: " + path);
+			return ret;
+		}
+
+		// Equality of the test operation, where numbers compare by value
+		static bool equal(const value &a, const value &b)
+		{
+			const bool a_number = a.type == value::types::INTEGER || a.type == value::types::REAL;
+			const bool b_number = b.type == value::types::INTEGER || b.type == value::types::REAL;
+			if(a_number && b_number && a.type != b.type)
+			{
+				const long double r = a.type == value::types::REAL ? boost::get<long double>(a.variant) : boost::get<long double>(b.variant);
+				const long long i = a.type == value::types::INTEGER ? boost::get<long long>(a.variant) : boost::get<long long>(b.variant);
+				return r == static_cast<long double>(i);
+			}
+			if(a.type == value::types::ARRAY && b.type == value::types::ARRAY)
+			{
+				const array &x = boost::get<array>(a.variant);
+				const array &y = boost::get<array>(b.variant);
+				return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin(), equal);
+			}
+			if(a.type == value::types::OBJECT && b.type == value::types::OBJECT)
+			{
+				// Both maps are sorted by key
+				const object &x = boost::get<object>(a.variant);
+				const object &y = boost::get<object>(b.variant);
+				return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin(),
+					[](const object::value_type &m, const object::value_type &n) { return m.first == n.first && equal(m.second, n.second); });
+			}
+			return a == b;
+		}
+
+		static const value& member(const value &op, const char *name)
+		{
+			const object &obj = boost::get<object>(op.variant);
+			auto it = obj.find(key::ref(name));
+			if(it == obj.end())
+				throw patch_error(std::string("Missing operation member: ") + name);
+			return it->second;
+		}
+
+		static const std::string& string_member(const value &op, const char *name)
+		{
+			const value &ret = member(op, name);
+			if(ret.type != value::types::STRING)
+				throw patch_error(std::string("Operation member isn't a string: ") + name);
+			return ret.to_string();
+		}
+
+	public:
+		patcher(value &_doc) : doc(_doc) {}
+
+		void apply(const value &op)
+		{
+			if(op.type != value::types::OBJECT)
+				throw patch_error("Operation isn't an object");
+
+			const std::string &name = string_member(op, "op");
+			const std::string &path = string_member(op, "path");
+
+			if(name == "add")
+				this->add(path, member(op, "value"));
+			else if(name == "remove")
+				this->remove(path);
+			else if(name == "replace")
+				this->get(path) = member(op, "value");
+			else if(name == "move")
+			{
+				const std::string &from = string_member(op, "from");
+				if(path.compare(0, from.size(), from) == 0 && (path.size() == from.size() || path[from.size()] == '/'))
+				{
+					if(path.size() != from.size())
+						throw patch_error("Can't move a value into itself: " + path);
+					return;
+				}
+				this->add(path, this->remove(from));
+			}
+			else if(name == "copy")
+			{
+				value copy = this->get(string_member(op, "from"));
+				this->add(path, copy);
+			}
+			else if(name == "test")
+			{
+				if(!equal(this->get(path), member(op, "value")))
+					throw patch_error("Test failed: " + path);
+			}
+			else
+				throw patch_error("Unknown operation: " + name);
+		}
+	};
+
+	// Applies an RFC 6902 patch in place. Operations are applied in order and
+	// the document is left partially patched if one fails.
+	inline void patch(value &doc, const value &ops)
+	{
+		if(ops.type != value::types::ARRAY)
+			throw patch_error("Patch isn't an array");
+
+		patcher p(doc);
+		for(const value &op : boost::get<array>(ops.variant))
+			p.apply(op);
+	}
+} //namespace json
@@ -0,0 +1,31 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+
+namespace json
+{
+	// JSON Pointer (RFC 6901) helpers
+	namespace pointer
+	{
+		inline std::string escape(const std::string &token)
+		{
+			std::string ret;
+			ret.reserve(token.size());
+			for(char c : token)
+			{
+				switch(c)
+				{
+				case '~':	ret += "~0"; break;
+				case '/':	ret += "~1"; break;
+				default:	ret += c;
+				}
+			}
+			return ret;
+		}
+	} // namespace pointer
+} //namespace json
@@ -0,0 +1,472 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <regex>
+#include <limits>
+#include <algorithm>
+
+#include "json.hpp"
+#include "json_pointer.hpp"
+
+namespace json
+{
+	// The schema itself is invalid or uses an unsupported keyword
+	class schema_error : public std::runtime_error
+	{
+	public:
+		schema_error(const std::string &m) : std::runtime_error(m) {}
+	};
+
+	class validation_error : public std::runtime_error
+	{
+	private:
+		std::string path;
+
+	public:
+		validation_error(const std::string &_path, const std::string &m)
+			: std::runtime_error(m + " at \"" + _path + "\""), path(_path) {}
+
+		// JSON pointer to the offending value
+		const std::string& get_path() const { return this->path; }
+	};
+
+	// Subset of JSON Schema: type, properties, required, items, enum of
+	// scalars, minimum, maximum, maxLength and pattern. The schema is compiled
+	// to a flat table of nodes, a validator checks the events of a parser
+	// against it and throws at the first violation, so no tree is built.
+	// Patterns run std::regex over the UTF-8 bytes, so they must be ASCII,
+	// and . or a negated class match a single byte of a longer character.
+	class schema
+	{
+	private:
+		enum { ANY = static_cast<size_t>(-1) };
+
+		enum type_bits
+		{
+			T_NULL		= 1 << 0,
+			T_BOOLEAN	= 1 << 1,
+			T_INTEGER	= 1 << 2,
+			T_NUMBER	= 1 << 3,	// reals, integers are numbers too
+			T_STRING	= 1 << 4,
+			T_ARRAY		= 1 << 5,
+			T_OBJECT	= 1 << 6,
+			T_ALL		= (1 << 7) - 1,
+		};
+
+		struct member
+		{
+			std::string name;
+			size_t node = ANY;		// from properties
+			size_t required = ANY;	// index among required members
+		};
+
+		struct node
+		{
+			unsigned types = T_ALL;
+			std::vector<member> members;	// sorted by name
+			size_t required = 0;
+			size_t items = ANY;
+			std::vector<value> enums;
+			bool has_enum = false;
+			long double minimum = -std::numeric_limits<long double>::infinity();
+			long double maximum = std::numeric_limits<long double>::infinity();
+			size_t max_length = ANY;
+			size_t pattern = ANY;
+		};
+
+		std::vector<node> nodes;
+		std::vector<std::regex> patterns;
+
+		static unsigned type_bit(const std::string &name)
+		{
+			if(name == "null")		return T_NULL;
+			if(name == "boolean")	return T_BOOLEAN;
+			if(name == "integer")	return T_INTEGER;
+			if(name == "number")	return T_NUMBER | T_INTEGER;
+			if(name == "string")	return T_STRING;
+			if(name == "array")		return T_ARRAY;
+			if(name == "object")	return T_OBJECT;
+			throw schema_error("Unknown type: " + name);
+		}
+
+		static const std::string& as_string(const value &v, const std::string &keyword)
+		{
+			if(v.type != value::types::STRING)
+				throw schema_error(keyword + " must be a string");
+			return v.to_string();
+		}
+
+		static long double as_number(const value &v, const std::string &keyword)
+		{
+			if(v.type == value::types::INTEGER)
+				return boost::get<long long>(v.variant);
+			if(v.type == value::types::REAL)
+				return boost::get<long double>(v.variant);
+			throw schema_error(keyword + " must be a number");
+		}
+
+		member& find_or_add(size_t index, const std::string &name)
+		{
+			std::vector<member> &members = this->nodes[index].members;
+			for(member &m : members)
+			{
+				if(m.name == name)
+					return m;
+			}
+			members.push_back(member());
+			members.back().name = name;
+			return members.back();
+		}
+
+		size_t compile(const value &s)
+		{
+			if(s.type != value::types::OBJECT)
+				throw schema_error("Schema must be an object");
+
+			// Indexes only, nodes moves as children are compiled
+			const size_t index = this->nodes.size();
+			this->nodes.push_back(node());
+
+			for(const auto &m : boost::get<object>(s.variant))
+			{
+				const std::string &k = m.first;
+				const value &v = m.second;
+
+				if(k == "type")
+				{
+					unsigned types = 0;
+					if(v.type == value::types::ARRAY)
+					{
+						for(const value &t : boost::get<array>(v.variant))
+							types |= type_bit(as_string(t, k));
+					}
+					else
+						types = type_bit(as_string(v, k));
+					this->nodes[index].types = types;
+				}
+				else if(k == "properties")
+				{
+					if(v.type != value::types::OBJECT)
+						throw schema_error("properties must be an object");
+					for(const auto &p : boost::get<object>(v.variant))
+					{
+						const size_t child = this->compile(p.second);
+						this->find_or_add(index, p.first).node = child;
+					}
+				}
+				else if(k == "required")
+				{
+					if(v.type != value::types::ARRAY)
+						throw schema_error("required must be an array");
+					for(const value &r : boost::get<array>(v.variant))
+					{
+						member &req = this->find_or_add(index, as_string(r, k));
+						if(req.required == ANY)
+							req.required = this->nodes[index].required++;
+					}
+				}
+				else if(k == "items")
+				{
+					if(v.type != value::types::OBJECT)
+						throw schema_error("Only a single schema is supported for items");
+					const size_t child = this->compile(v);
+					this->nodes[index].items = child;
+				}
+				else if(k == "enum")
+				{
+					if(v.type != value::types::ARRAY)
+						throw schema_error("enum must be an array");
+					for(const value &e : boost::get<array>(v.variant))
+					{
+						if(e.type == value::types::ARRAY || e.type == value::types::OBJECT)
+							throw schema_error("Only scalars are supported in enum");
+						this->nodes[index].enums.push_back(e);
+					}
+					this->nodes[index].has_enum = true;
+				}
+				else if(k == "minimum")
+					this->nodes[index].minimum = as_number(v, k);
+				else if(k == "maximum")
+					this->nodes[index].maximum = as_number(v, k);
+				else if(k == "maxLength")
+				{
+					if(v.type != value::types::INTEGER || boost::get<long long>(v.variant) < 0)
+						throw schema_error("maxLength must be a non-negative integer");
+					this->nodes[index].max_length = boost::get<long long>(v.variant);
+				}
+				else if(k == "pattern")
+				{
+					const std::string &pattern = as_string(v, k);
+					if(std::any_of(pattern.begin(), pattern.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+						throw schema_error("Non ASCII patterns aren't supported: " + pattern);
+					try
+					{
+						this->patterns.push_back(std::regex(pattern, std::regex::ECMAScript | std::regex::optimize));
+					}
+					catch(std::regex_error &e)
+					{
+						throw schema_error("Invalid pattern: " + pattern);
+					}
+					this->nodes[index].pattern = this->patterns.size() - 1;
+				}
+				else if(k != "$schema" && k != "$id" && k != "id" && k != "title" && k != "description"
+					&& k != "default" && k != "examples" && k != "$comment")
+				{
+					// Ignoring it would accept documents the schema rejects
+					throw schema_error("Unsupported schema keyword: " + k);
+				}
+			}
+
+			std::vector<member> &members = this->nodes[index].members;
+			std::sort(members.begin(), members.end(), [](const member &a, const member &b) { return a.name < b.name; });
+			return index;
+		}
+
+	public:
+		schema(const value &s)
+		{
+			this->compile(s);
+		}
+
+		// Parser handler, checks a document against the schema as it's parsed.
+		// Its stacks are kept between documents, reuse it to avoid allocating.
+		class validator
+		{
+		private:
+			struct frame
+			{
+				size_t node;
+				bool object;
+				size_t count;		// elements seen so far
+				std::string key;	// current member
+				size_t child;		// node of the current member
+				size_t seen;		// offset of the required bits in validator::bits
+			};
+
+			const schema &s;
+			std::vector<frame> frames;	// only grows, depth is the part in use
+			size_t depth = 0;
+			std::vector<uint64_t> bits;
+
+			std::string path(size_t levels) const
+			{
+				std::string ret;
+				for(size_t i = 0; i < levels; i++)
+				{
+					const frame &f = this->frames[i];
+					ret += '/';
+					ret += f.object ? pointer::escape(f.key) : std::to_string(f.count - 1);
+				}
+				return ret;
+			}
+
+			void fail(const std::string &message, size_t levels) const
+			{
+				throw validation_error(this->path(levels), message);
+			}
+
+			void fail(const std::string &message) const
+			{
+				this->fail(message, this->depth);
+			}
+
+			// Node of the value starting now
+			size_t current()
+			{
+				if(this->depth == 0)
+					return 0;
+
+				frame &top = this->frames[this->depth - 1];
+				if(top.object)
+					return top.child;
+				top.count++;
+				return top.node == ANY ? ANY : this->s.nodes[top.node].items;
+			}
+
+			const node* check_type(size_t n, unsigned bit)
+			{
+				if(n == ANY)
+					return nullptr;
+
+				const node &ret = this->s.nodes[n];
+				if((ret.types & bit) == 0)
+					this->fail("Unexpected type");
+				return &ret;
+			}
+
+			void check_enum(const node &n, const value &v)
+			{
+				if(!n.has_enum)
+					return;
+				for(const value &e : n.enums)
+				{
+					if(e == v)
+						return;
+				}
+				this->fail("Value not in enum");
+			}
+
+			void check_number(size_t index, long double v, bool integral)
+			{
+				const node *n = this->check_type(index, integral ? T_INTEGER : T_NUMBER);
+				if(n == nullptr)
+					return;
+				if(v < n->minimum)
+					this->fail("Value below minimum");
+				if(v > n->maximum)
+					this->fail("Value above maximum");
+				if(n->has_enum)
+				{
+					for(const value &e : n->enums)
+					{
+						if((e.type == value::types::INTEGER && boost::get<long long>(e.variant) == v)
+							|| (e.type == value::types::REAL && boost::get<long double>(e.variant) == v))
+							return;
+					}
+					this->fail("Value not in enum");
+				}
+			}
+
+			void push(size_t n, bool object)
+			{
+				if(this->depth == this->frames.size())
+					this->frames.push_back(frame());
+
+				frame &f = this->frames[this->depth++];
+				f.node = n;
+				f.object = object;
+				f.count = 0;
+				f.child = ANY;
+				f.seen = this->bits.size();
+				if(object && n != ANY)
+					this->bits.resize(this->bits.size() + (this->s.nodes[n].required + 63) / 64, 0);
+			}
+
+		public:
+			validator(const schema &_s) : s(_s) {}
+
+			void begin_object()
+			{
+				const size_t n = this->current();
+				this->check_type(n, T_OBJECT);
+				this->push(n, true);
+			}
+
+			void key(const std::string &k)
+			{
+				frame &f = this->frames[this->depth - 1];
+				f.key = k;
+				f.child = ANY;
+				if(f.node == ANY)
+					return;
+
+				const std::vector<member> &members = this->s.nodes[f.node].members;
+				auto it = std::lower_bound(members.begin(), members.end(), k,
+					[](const member &m, const std::string &name) { return m.name < name; });
+				if(it == members.end() || it->name != k)
+					return;
+
+				f.child = it->node;
+				if(it->required != ANY)
+					this->bits[f.seen + it->required / 64] |= 1ull << (it->required % 64);
+			}
+
+			void end_object()
+			{
+				const frame &f = this->frames[this->depth - 1];
+				if(f.node != ANY)
+				{
+					for(const member &m : this->s.nodes[f.node].members)
+					{
+						if(m.required != ANY && (this->bits[f.seen + m.required / 64] & (1ull << (m.required % 64))) == 0)
+							this->fail("Missing required member " + m.name, this->depth - 1);
+					}
+				}
+				this->bits.resize(f.seen);
+				this->depth--;
+			}
+
+			void begin_array()
+			{
+				const size_t n = this->current();
+				this->check_type(n, T_ARRAY);
+				this->push(n, false);
+			}
+
+			void end_array()
+			{
+				this->depth--;
+			}
+
+			void null()
+			{
+				if(const node *n = this->check_type(this->current(), T_NULL))
+					this->check_enum(*n, value());
+			}
+
+			void boolean(bool v)
+			{
+				if(const node *n = this->check_type(this->current(), T_BOOLEAN))
+					this->check_enum(*n, v);
+			}
+
+			void integer(long long v)
+			{
+				this->check_number(this->current(), v, true);
+			}
+
+			void real(long double v)
+			{
+				// Integral reals are integers to JSON Schema
+				this->check_number(this->current(), v, v == std::trunc(v));
+			}
+
+			void string(const std::string &v)
+			{
+				const node *n = this->check_type(this->current(), T_STRING);
+				if(n == nullptr)
+					return;
+
+				if(n->max_length != ANY)
+				{
+					// Length in code points, continuation bytes don't count
+					size_t length = 0;
+					for(char c : v)
+						length += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+					if(length > n->max_length)
+						this->fail("String longer than maxLength");
+				}
+				if(n->pattern != ANY && !std::regex_search(v, this->s.patterns[n->pattern]))
+					this->fail("String doesn't match pattern");
+				if(n->has_enum)
+				{
+					for(const value &e : n->enums)
+					{
+						if(e.type == value::types::STRING && e.to_string() == v)
+							return;
+					}
+					this->fail("Value not in enum");
+				}
+			}
+
+			// Called by the parser before each document, drops what a document
+			// that failed half way left
+			void begin_document()
+			{
+				this->depth = 0;
+				this->bits.clear();
+			}
+		};
+
+		// Parses stream only to validate it, throws validation_error if invalid
+		void validate(std::istream &stream) const
+		{
+			validator v(*this);
+			parser(stream).parse(v);
+		}
+	};
+} //namespace json
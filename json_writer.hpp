@@ -0,0 +1,236 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <type_traits>
+
+#include "json.hpp"
+
+namespace json
+{
+	// Writes a document as it's described, without building it: output goes
+	// to a fixed size buffer written to the sink whenever it's full, so memory
+	// doesn't depend on the size of the document.
+	// Nesting is only checked by asserts, in debug builds.
+	class writer
+	{
+	private:
+		std::ostream &sink;
+		std::vector<char> buffer;
+		size_t used = 0;
+
+		// Between two members or elements
+		bool comma = false;
+
+#ifndef NDEBUG
+		// One of '{', '[' or ':' (a key waiting for its value) per level
+		std::vector<char> nesting;
+		bool done = false;
+
+		void check_value()
+		{
+			assert(!this->done && "Only one root value per writer");
+			assert((this->nesting.empty() || this->nesting.back() != '{') && "Object members need a key");
+			if(!this->nesting.empty() && this->nesting.back() == ':')
+				this->nesting.pop_back();
+			this->done = this->nesting.empty();
+		}
+#endif
+
+		void separate()
+		{
+			if(this->comma)
+				this->put(',');
+		}
+
+		void put(char c)
+		{
+			if(this->used == this->buffer.size())
+				this->flush();
+			this->buffer[this->used++] = c;
+		}
+
+		void begin(char c)
+		{
+#ifndef NDEBUG
+			this->check_value();
+			this->done = false;
+			this->nesting.push_back(c);
+#endif
+			this->separate();
+			this->put(c);
+			this->comma = false;
+		}
+
+		void end(char c)
+		{
+#ifndef NDEBUG
+			assert(!this->nesting.empty() && this->nesting.back() == (c == '}' ? '{' : '[') && "Unbalanced end");
+			this->nesting.pop_back();
+			this->done = this->nesting.empty();
+#endif
+			this->put(c);
+			this->comma = true;
+		}
+
+		writer& scalar(const char *str, size_t size)
+		{
+#ifndef NDEBUG
+			this->check_value();
+#endif
+			this->separate();
+			this->write(str, size);
+			this->comma = true;
+			return *this;
+		}
+
+	public:
+		writer(std::ostream &_sink, size_t chunk = 64 * 1024) : sink(_sink), buffer(std::max<size_t>(chunk, 1)) {}
+
+		writer(const writer&) = delete;
+		writer& operator=(const writer&) = delete;
+
+		~writer()
+		{
+			this->flush();
+		}
+
+		// Raw output, what escape_to() writes through
+		void write(const char *str, size_t size)
+		{
+			if(this->used + size > this->buffer.size())
+			{
+				this->flush();
+				if(size > this->buffer.size())
+				{
+					this->sink.write(str, size);
+					return;
+				}
+			}
+			std::memcpy(this->buffer.data() + this->used, str, size);
+			this->used += size;
+		}
+
+		size_t buffered() const
+		{
+			return this->used;
+		}
+
+		void flush()
+		{
+			this->sink.write(this->buffer.data(), this->used);
+			this->used = 0;
+		}
+
+		writer& begin_object()	{ this->begin('{'); return *this; }
+		writer& end_object()	{ this->end('}'); return *this; }
+		writer& begin_array()	{ this->begin('['); return *this; }
+		writer& end_array()		{ this->end(']'); return *this; }
+
+		writer& key(const char *str, size_t size)
+		{
+#ifndef NDEBUG
+			assert(!this->nesting.empty() && this->nesting.back() == '{' && "Keys only go in objects, once per member");
+			this->nesting.push_back(':');
+#endif
+			this->separate();
+			escape_to(*this, str, size);
+			this->put(':');
+			this->comma = false;
+			return *this;
+		}
+
+		writer& key(const std::string &str)
+		{
+			return this->key(str.data(), str.size());
+		}
+
+		writer& null()
+		{
+			return this->scalar("null", 4);
+		}
+
+		writer& value(bool val)
+		{
+			return val ? this->scalar("true", 4) : this->scalar("false", 5);
+		}
+
+		template<typename tInteger>
+		typename std::enable_if<std::is_integral<tInteger>::value && std::is_signed<tInteger>::value, writer&>::type
+		value(tInteger val)
+		{
+			char buffer[32];
+			return this->scalar(buffer, format_integer(buffer, static_cast<long long>(val)));
+		}
+
+		template<typename tInteger>
+		typename std::enable_if<std::is_integral<tInteger>::value && !std::is_signed<tInteger>::value, writer&>::type
+		value(tInteger val)
+		{
+			char buffer[32];
+			return this->scalar(buffer, format_integer(buffer, static_cast<unsigned long long>(val)));
+		}
+
+		writer& value(long double val)
+		{
+			char buffer[32];
+			return this->scalar(buffer, format_real(buffer, val));
+		}
+
+		writer& value(double val)
+		{
+			return this->value(static_cast<long double>(val));
+		}
+
+		writer& value(const char *str, size_t size)
+		{
+#ifndef NDEBUG
+			this->check_value();
+#endif
+			this->separate();
+			escape_to(*this, str, size);
+			this->comma = true;
+			return *this;
+		}
+
+		writer& value(const char *str)
+		{
+			return this->value(str, std::strlen(str));
+		}
+
+		writer& value(const std::string &str)
+		{
+			return this->value(str.data(), str.size());
+		}
+
+		// Writes a whole tree, for the parts of a document already built
+		writer& value(const json::value &val)
+		{
+			switch(val.type)
+			{
+			case json::value::types::NONE:		return *this;
+			case json::value::types::NILL:		return this->null();
+			case json::value::types::BOOLEAN:	return this->value(boost::get<long long>(val.variant) != 0);
+			case json::value::types::INTEGER:	return this->value(boost::get<long long>(val.variant));
+			case json::value::types::REAL:		return this->value(boost::get<long double>(val.variant));
+			case json::value::types::STRING:	return this->value(val.to_string());
+			case json::value::types::ARRAY:
+				this->begin_array();
+				for(const json::value &v : boost::get<array>(val.variant))
+					this->value(v);
+				return this->end_array();
+			case json::value::types::OBJECT:
+				this->begin_object();
+				for(const auto &m : boost::get<object>(val.variant))
+					this->key(m.first).value(m.second);
+				return this->end_object();
+			}
+
+			// unreachable
+			return *this;
+		}
+	};
+} //namespace json
@@ -6,10 +6,13 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <array>
 #include <istream>
+#include <algorithm>
 
 #include "byteorder.hpp"
+#include "instrument.hpp"
 
 namespace boost {
 namespace network {
@@ -21,9 +24,14 @@ public:
 	typedef std::array<uint32_t, 4> digest;
 
 private:
-	std::istream &source;
-	size_t pos = 0, size = 0;
-	size_t nbwords;
+	std::istream *source;
+	uint64_t size = 0;
+
+	// Pending bytes of an incomplete block
+	unsigned char block[64];
+	size_t used = 0;
+
+	VITRINE_INSTRUMENT_ONLY(::instrument::counters stats;)
 
 	uint32_t A = byteorder::little(0x67452301);
 	uint32_t B = byteorder::little(0xefcdab89);
@@ -64,73 +72,25 @@ private:
 		a = b + leftrotate((a + (c ^ (b | ~(d))) + x + t), s);
 	}
 	
-	inline uint32_t next_word()
+	inline void transform(const unsigned char *block)
 	{
-		int read = 0;
-		unsigned char c[4];
-		
-		if(!source.eof())
+		uint32_t X[16];
+		for(size_t j = 0; j < 16; j++)
 		{
-			for(read = 0; !source.eof() && (read < 4); read++)
-				c[read] = source.get();
-			
-			if(!source.eof())
-			{
-				pos += 4;
-			
-				return byteorder::little(
-					  (static_cast<uint32_t>(c[0]) <<  0)
-					| (static_cast<uint32_t>(c[1]) <<  8)
-					| (static_cast<uint32_t>(c[2]) << 16)
-					| (static_cast<uint32_t>(c[3]) << 24));
-			}
-			else
-			{
-				this->size = this->pos + (--read);
+			X[j] = (static_cast<uint32_t>(block[j * 4 + 0]) <<  0)
+				 | (static_cast<uint32_t>(block[j * 4 + 1]) <<  8)
+				 | (static_cast<uint32_t>(block[j * 4 + 2]) << 16)
+				 | (static_cast<uint32_t>(block[j * 4 + 3]) << 24);
+		}
 
-				size_t chunks = ((this->size) / 64) + 1;
-				this->nbwords = chunks * 16;
-				
-				this->pos += 4;
+		uint32_t AA = A, BB = B, CC = C, DD = D;
 
-				switch(read)
-				{
-					case 0:
-						return byteorder::little(0x00000080);
-					case 1:
-						return byteorder::little(
-							  (static_cast<uint32_t>(c[0]) <<  0)
-							| 0x00008000);
-					case 2:
-						return byteorder::little(
-							  (static_cast<uint32_t>(c[0]) <<  0)
-							| (static_cast<uint32_t>(c[1]) <<  8)
-							| 0x00800000);
-					case 3:
-						return byteorder::little(
-							  (static_cast<uint32_t>(c[0]) <<  0)
-							| (static_cast<uint32_t>(c[1]) <<  8)
-							| (static_cast<uint32_t>(c[2]) << 16)
-							| 0x80000000);
-				}
-			}
-		}
-		else
-		{
-			this->pos += 4;
-		
-			if((this->pos / 4) >= this->nbwords - 2)
-			{
-				
-				if((pos / 4) == this->nbwords - 1)
-					return byteorder::little(static_cast<uint32_t>((this->size * 8) >> 0));
-				else if((pos / 4) == this->nbwords - 0)
-					return byteorder::little(static_cast<uint32_t>((this->size * 8) >> 32));
-			}
-			else
-				return 0x00000000;
-		}
-		return 0x00000000;
+		this->step(X);
+
+		A += AA;
+		B += BB;
+		C += CC;
+		D += DD;
 	}
 
 	inline void step(const uint32_t X[16])
@@ -221,39 +181,91 @@ private:
 	}
 
 public:
-	md5(std::istream &target) : source(target)
+	// Incremental mode, feed data with update() then get the digest with finish()
+	md5() : source(nullptr)
 	{
 	}
 
-	digest hash()
+	md5(std::istream &target) : source(&target)
 	{
-		uint32_t AA, BB, CC, DD;
-		uint32_t X[16];
+	}
+
+	md5& update(const void *data, size_t len)
+	{
+		const unsigned char *in = static_cast<const unsigned char*>(data);
+		this->size += len;
 
-		for(size_t i = 0; !source.eof() || (i < this->nbwords); i+=16)
+		if(this->used != 0)
 		{
-			AA = A;
-			BB = B;
-			CC = C;
-			DD = D;
+			const size_t fill = std::min(len, sizeof(this->block) - this->used);
+			std::memcpy(this->block + this->used, in, fill);
+			this->used += fill;
+			in += fill;
+			len -= fill;
+
+			if(this->used < sizeof(this->block))
+				return *this;
+			this->transform(this->block);
+			this->used = 0;
+		}
 
-			for(size_t j = 0; j < 16; j++)
-				X[j] = this->next_word();
+		for(; len >= 64; in += 64, len -= 64)
+			this->transform(in);
 
-			this->step(X);
+		std::memcpy(this->block, in, len);
+		this->used = len;
+		return *this;
+	}
 
-			A += AA;
-			B += BB;
-			C += CC;
-			D += DD;
+	// Feeds the 16 bytes of a digest, in the order they are printed
+	md5& update(const digest &d)
+	{
+		unsigned char bytes[16];
+		for(size_t i = 0; i < 4; i++)
+		{
+			bytes[i * 4 + 0] = static_cast<unsigned char>(d[i] >> 24);
+			bytes[i * 4 + 1] = static_cast<unsigned char>(d[i] >> 16);
+			bytes[i * 4 + 2] = static_cast<unsigned char>(d[i] >>  8);
+			bytes[i * 4 + 3] = static_cast<unsigned char>(d[i] >>  0);
 		}
-	
+		return this->update(bytes, sizeof(bytes));
+	}
+
+	digest finish()
+	{
+		const uint64_t bits = this->size * 8;
+
+		unsigned char padding[72] = {0x80};
+		size_t count = (this->used < 56 ? 56 : 120) - this->used;
+		for(size_t i = 0; i < 8; i++)
+			padding[count + i] = static_cast<unsigned char>(bits >> (i * 8));
+		this->update(padding, count + 8);
+
+		VITRINE_INSTRUMENT_ONLY(
+			this->stats.hashed_bytes = bits / 8;
+			this->stats.hashes++;
+			::instrument::record_hash(this->stats);
+			this->stats = ::instrument::counters();
+		)
+
 		return {{
 			byteorder::big(A),
 			byteorder::big(B),
 			byteorder::big(C),
 			byteorder::big(D)}};
 	}
+
+	digest hash()
+	{
+		if(this->source != nullptr)
+		{
+			VITRINE_INSTRUMENT_ONLY(::instrument::timer t(this->stats.nanoseconds[::instrument::HASH]);)
+			char buffer[16 * 1024];
+			while(this->source->read(buffer, sizeof(buffer)) || this->source->gcount() > 0)
+				this->update(buffer, static_cast<size_t>(this->source->gcount()));
+		}
+		return this->finish();
+	}
 };
 
 } // namespace hashs
@@ -0,0 +1,321 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "md5.hpp"
+
+namespace boost {
+namespace network {
+namespace hashs {
+
+// Persistent digests of files, keyed by (device, inode, size, mtime). The
+// index is a fixed size open addressing table in a memory mapped file, so a
+// warm lookup costs one stat() and no read of the file.
+//
+// Each entry is guarded by a sequence counter: readers never block and retry
+// if a writer was in the middle of it, writers claim an entry with a CAS and
+// give up if it's already claimed. An entry still claimed after a while was
+// left by a crashed writer and is taken over, a check word over its fields
+// catches the late stores of a writer that was only slow.
+// As the counters live in the mapping, several processes can share the file.
+// The index is validated and created under an flock(), so two processes
+// opening a new one don't size it under each other's mapping.
+class md5_cache
+{
+private:
+	struct header
+	{
+		char magic[8];
+		uint64_t capacity;
+	};
+
+	struct entry
+	{
+		std::atomic<uint64_t> seq;	// odd while being written
+		std::atomic<uint64_t> dev, ino, size, mtime;
+		std::atomic<uint32_t> digest[4];
+		std::atomic<uint64_t> check;
+	};
+
+	// Entries probed from the home slot before giving up or evicting
+	enum { probes = 8 };
+
+	// Yields waited on a claimed entry before deciding its writer is gone
+	enum { stale_spins = 1 << 16 };
+
+	int fd = -1;
+	void *mapping = nullptr;
+	size_t length = 0;
+	uint64_t capacity;
+	entry *entries = nullptr;
+
+	mutable std::atomic<uint64_t> nb_hits, nb_misses;
+
+	static const char* magic()
+	{
+		return "md5cach2";
+	}
+
+	static uint64_t checksum(uint64_t dev, uint64_t ino, uint64_t size, uint64_t mtime, const md5::digest &d)
+	{
+		uint64_t h = 0xCBF29CE484222325ull;
+		const uint64_t words[] = {dev, ino, size, mtime,
+			(static_cast<uint64_t>(d[0]) << 32) | d[1], (static_cast<uint64_t>(d[2]) << 32) | d[3]};
+		for(const uint64_t w : words)
+		{
+			h = (h ^ w) * 0x100000001B3ull;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	static uint64_t mtime_ns(const struct stat &st)
+	{
+		return static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull + st.st_mtim.tv_nsec;
+	}
+
+	size_t home(const struct stat &st) const
+	{
+		uint64_t h = static_cast<uint64_t>(st.st_dev) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(st.st_ino);
+		h ^= h >> 31;
+		h *= 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 29;
+		return static_cast<size_t>(h & (this->capacity - 1));
+	}
+
+	static void fail(const char *what)
+	{
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	void map(bool init)
+	{
+		this->length = sizeof(header) + this->capacity * sizeof(entry);
+		if(init && ftruncate(this->fd, 0) != 0)
+			fail("Can't truncate md5 cache");
+		if(init && ftruncate(this->fd, this->length) != 0)
+			fail("Can't size md5 cache");
+
+		this->mapping = mmap(nullptr, this->length, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+		if(this->mapping == MAP_FAILED)
+		{
+			this->mapping = nullptr;
+			fail("Can't map md5 cache");
+		}
+
+		header *h = static_cast<header*>(this->mapping);
+		if(init)
+		{
+			std::memcpy(h->magic, magic(), sizeof(h->magic));
+			h->capacity = this->capacity;
+		}
+		this->entries = reinterpret_cast<entry*>(h + 1);
+	}
+
+public:
+	// capacity is rounded up to a power of two, an existing index keeps its own
+	md5_cache(const std::string &path, size_t _capacity = 1 << 18)
+		: capacity(1), nb_hits(0), nb_misses(0)
+	{
+		while(this->capacity < _capacity)
+			this->capacity <<= 1;
+
+		this->fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if(this->fd < 0)
+			fail("Can't open md5 cache");
+
+		try
+		{
+			// Once valid the file is never resized, the lock is only needed
+			// until it is
+			if(flock(this->fd, LOCK_EX) != 0)
+				fail("Can't lock md5 cache");
+
+			struct stat st;
+			if(fstat(this->fd, &st) != 0)
+				fail("Can't stat md5 cache");
+
+			header h;
+			bool valid = static_cast<size_t>(st.st_size) >= sizeof(header)
+				&& pread(this->fd, &h, sizeof(h), 0) == sizeof(h)
+				&& std::memcmp(h.magic, magic(), sizeof(h.magic)) == 0
+				&& h.capacity != 0 && (h.capacity & (h.capacity - 1)) == 0
+				&& static_cast<uint64_t>(st.st_size) == sizeof(header) + h.capacity * sizeof(entry);
+
+			if(valid)
+				this->capacity = h.capacity;
+			this->map(!valid);
+			flock(this->fd, LOCK_UN);
+		}
+		catch(...)
+		{
+			// Also drops the lock
+			close(this->fd);
+			throw;
+		}
+	}
+
+	md5_cache(const md5_cache&) = delete;
+	md5_cache& operator=(const md5_cache&) = delete;
+
+	~md5_cache()
+	{
+		if(this->mapping != nullptr)
+			munmap(this->mapping, this->length);
+		if(this->fd >= 0)
+			close(this->fd);
+	}
+
+	bool lookup(const struct stat &st, md5::digest &out) const
+	{
+		const uint64_t mtime = mtime_ns(st);
+		const size_t start = this->home(st);
+
+		for(size_t i = 0; i < probes; i++)
+		{
+			const entry &e = this->entries[(start + i) & (this->capacity - 1)];
+
+			for(;;)
+			{
+				// Being written, or left half written by a crashed writer
+				const uint64_t before = e.seq.load(std::memory_order_acquire);
+				if(before & 1)
+					break;
+
+				const uint64_t dev = e.dev.load(std::memory_order_relaxed);
+				const uint64_t ino = e.ino.load(std::memory_order_relaxed);
+				const uint64_t size = e.size.load(std::memory_order_relaxed);
+				const uint64_t time = e.mtime.load(std::memory_order_relaxed);
+				md5::digest d;
+				for(size_t j = 0; j < 4; j++)
+					d[j] = e.digest[j].load(std::memory_order_relaxed);
+				const uint64_t check = e.check.load(std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if(e.seq.load(std::memory_order_relaxed) != before)
+					continue;
+
+				if(before == 0)
+				{
+					// Never written, the file can't be further
+					this->nb_misses++;
+					return false;
+				}
+				// A mismatched check is a mix of two writers' stores
+				if(dev == static_cast<uint64_t>(st.st_dev) && ino == static_cast<uint64_t>(st.st_ino)
+					&& size == static_cast<uint64_t>(st.st_size) && time == mtime
+					&& check == checksum(dev, ino, size, time, d))
+				{
+					out = d;
+					this->nb_hits++;
+					return true;
+				}
+				break;
+			}
+		}
+
+		this->nb_misses++;
+		return false;
+	}
+
+	void store(const struct stat &st, const md5::digest &d)
+	{
+		const size_t start = this->home(st);
+
+		// Same file first, then a free entry, else evict the home entry
+		entry *target = nullptr;
+		for(size_t i = 0; i < probes && target == nullptr; i++)
+		{
+			entry &e = this->entries[(start + i) & (this->capacity - 1)];
+			if(e.seq.load(std::memory_order_acquire) == 0
+				|| (e.dev.load(std::memory_order_relaxed) == static_cast<uint64_t>(st.st_dev)
+					&& e.ino.load(std::memory_order_relaxed) == static_cast<uint64_t>(st.st_ino)))
+				target = &e;
+		}
+		if(target == nullptr)
+			target = &this->entries[start];
+
+		// Another writer owns the entry, dropping this digest is fine for a
+		// cache, unless it holds it for so long that it must have crashed
+		uint64_t seq = target->seq.load(std::memory_order_relaxed);
+		if(seq & 1)
+		{
+			for(size_t i = 0; i < stale_spins && target->seq.load(std::memory_order_relaxed) == seq; i++)
+				std::this_thread::yield();
+			if(target->seq.load(std::memory_order_relaxed) != seq)
+				return;
+		}
+
+		// Taking over keeps the counter odd
+		const uint64_t claimed = (seq & 1) ? seq + 2 : seq + 1;
+		if(!target->seq.compare_exchange_strong(seq, claimed, std::memory_order_acquire))
+			return;
+
+		const uint64_t mtime = mtime_ns(st);
+		target->dev.store(st.st_dev, std::memory_order_relaxed);
+		target->ino.store(st.st_ino, std::memory_order_relaxed);
+		target->size.store(st.st_size, std::memory_order_relaxed);
+		target->mtime.store(mtime, std::memory_order_relaxed);
+		for(size_t j = 0; j < 4; j++)
+			target->digest[j].store(d[j], std::memory_order_relaxed);
+		target->check.store(checksum(st.st_dev, st.st_ino, st.st_size, mtime, d), std::memory_order_relaxed);
+
+		// Fails if the entry was taken over meanwhile, its new owner releases it
+		uint64_t expected = claimed;
+		target->seq.compare_exchange_strong(expected, claimed + 1, std::memory_order_release, std::memory_order_relaxed);
+	}
+
+	// Digest of the file at path, only read if it changed since it was cached
+	md5::digest hash(const std::string &path)
+	{
+		struct stat before;
+		if(stat(path.c_str(), &before) != 0)
+			fail("Can't stat file");
+
+		md5::digest ret;
+		if(this->lookup(before, ret))
+			return ret;
+
+		std::ifstream is(path, std::ios::in | std::ios::binary);
+		if(!is.is_open())
+			fail("Can't open file");
+		ret = md5(is).hash();
+
+		// Don't cache a digest of a file modified while it was read
+		struct stat after;
+		if(stat(path.c_str(), &after) == 0 && after.st_ino == before.st_ino
+			&& after.st_size == before.st_size && mtime_ns(after) == mtime_ns(before))
+			this->store(before, ret);
+		return ret;
+	}
+
+	// Writes the index back to disk, the kernel does it eventually anyway
+	void flush()
+	{
+		if(msync(this->mapping, this->length, MS_SYNC) != 0)
+			fail("Can't sync md5 cache");
+	}
+
+	uint64_t hits() const	{ return this->nb_hits.load(); }
+	uint64_t misses() const	{ return this->nb_misses.load(); }
+};
+
+} // namespace hashs
+} // namespace network
+} // namespace boost
@@ -0,0 +1,165 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include <istream>
+#include <cstring>
+#include <stdexcept>
+
+#include "md5.hpp"
+
+namespace boost {
+namespace network {
+namespace hashs {
+
+// Content defined chunking (FastCDC) of a stream, each chunk fingerprinted
+// with md5. Boundaries depend on the content around them, not on offsets,
+// so inserting bytes only changes the chunks next to the insertion.
+class md5_chunker
+{
+public:
+	struct chunk
+	{
+		uint64_t offset;
+		size_t size;
+		md5::digest digest;
+	};
+
+private:
+	std::istream &source;
+	size_t min_size, avg_size, max_size;
+
+	// Harder to match below the average size, easier above: chunk sizes
+	// cluster around the average ("normalized chunking")
+	uint64_t mask_small, mask_large;
+
+	std::vector<unsigned char> buffer;
+	size_t begin = 0, end = 0;
+	uint64_t offset = 0;
+
+	// Random values for the Gear rolling hash, from splitmix64 so they're the
+	// same on every platform and boundaries can be compared between machines
+	static const uint64_t* gear()
+	{
+		struct table
+		{
+			uint64_t values[256];
+
+			table()
+			{
+				uint64_t state = 0x6d643563686b6572ull;
+				for(uint64_t &v : this->values)
+				{
+					uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+					z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+					z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+					v = z ^ (z >> 31);
+				}
+			}
+		};
+		static const table t;
+		return t.values;
+	}
+
+	// Mask of the bits top bits, the ones depending on the most recent bytes
+	static uint64_t mask(unsigned bits)
+	{
+		return bits == 0 ? 0 : ~0ull << (64 - bits);
+	}
+
+	void fill()
+	{
+		if(this->end - this->begin >= this->max_size || !this->source.good())
+			return;
+
+		std::memmove(this->buffer.data(), this->buffer.data() + this->begin, this->end - this->begin);
+		this->end -= this->begin;
+		this->begin = 0;
+
+		while(this->end < this->buffer.size() && this->source.good())
+		{
+			this->source.read(reinterpret_cast<char*>(this->buffer.data() + this->end), this->buffer.size() - this->end);
+			this->end += static_cast<size_t>(this->source.gcount());
+		}
+	}
+
+	size_t cut(const unsigned char *data, size_t size) const
+	{
+		if(size <= this->min_size)
+			return size;
+
+		const uint64_t *g = gear();
+		const size_t normal = std::min(this->avg_size, size);
+		const size_t limit = std::min(this->max_size, size);
+
+		// Nothing can cut below the minimum, don't even hash it
+		uint64_t h = 0;
+		size_t i = this->min_size;
+		for(; i < normal; i++)
+		{
+			h = (h << 1) + g[data[i]];
+			if((h & this->mask_small) == 0)
+				return i + 1;
+		}
+		for(; i < limit; i++)
+		{
+			h = (h << 1) + g[data[i]];
+			if((h & this->mask_large) == 0)
+				return i + 1;
+		}
+		return limit;
+	}
+
+public:
+	md5_chunker(std::istream &_source, size_t avg = 8 * 1024)
+		: md5_chunker(_source, avg / 4, avg, avg * 8)
+	{
+	}
+
+	md5_chunker(std::istream &_source, size_t min, size_t avg, size_t max)
+		: source(_source), min_size(min), avg_size(avg), max_size(max)
+	{
+		if(min == 0 || min > avg || avg > max)
+			throw std::invalid_argument("Chunk sizes must verify 0 < min <= avg <= max");
+
+		unsigned bits = 0;
+		while((static_cast<size_t>(2) << bits) <= avg)
+			bits++;
+		this->mask_small = mask(bits + 2);
+		this->mask_large = mask(bits > 2 ? bits - 2 : 0);
+
+		// Large enough for the buffer to be refilled in big reads
+		this->buffer.resize(std::max<size_t>(max * 4, 1 << 20));
+	}
+
+	// Fills out with the next chunk, returns false once the stream is exhausted
+	bool next(chunk &out)
+	{
+		this->fill();
+		if(this->begin == this->end)
+			return false;
+
+		const unsigned char *data = this->buffer.data() + this->begin;
+		const size_t size = this->cut(data, this->end - this->begin);
+
+		// Hashed right away, while the chunk is still in cache
+		md5 h;
+		h.update(data, size);
+
+		out.offset = this->offset;
+		out.size = size;
+		out.digest = h.finish();
+
+		this->begin += size;
+		this->offset += size;
+		return true;
+	}
+};
+
+} // namespace hashs
+} // namespace network
+} // namespace boost
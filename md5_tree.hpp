@@ -0,0 +1,237 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "md5.hpp"
+
+namespace boost {
+namespace network {
+namespace hashs {
+
+// Chunked md5: the input is split in fixed size chunks hashed in parallel,
+// the root is the md5 of the concatenated chunk digests, like S3 multipart
+// ETags. It is NOT the md5 of the whole input, but chunks can be verified
+// and re-hashed on their own.
+class md5_tree
+{
+public:
+	struct result
+	{
+		uint64_t size;
+		md5::digest root;
+		std::vector<md5::digest> chunks;
+	};
+
+private:
+	size_t chunk_size;
+	unsigned threads;
+
+	class file
+	{
+	public:
+		int fd;
+
+		file(const std::string &path) : fd(open(path.c_str(), O_RDONLY))
+		{
+			if(this->fd < 0)
+				throw std::system_error(errno, std::generic_category(), "Can't open " + path);
+		}
+
+		file(const file&) = delete;
+		file& operator=(const file&) = delete;
+
+		~file()
+		{
+			close(this->fd);
+		}
+
+		uint64_t size() const
+		{
+			struct stat st;
+			if(fstat(this->fd, &st) != 0)
+				throw std::system_error(errno, std::generic_category(), "Can't stat file");
+			return st.st_size;
+		}
+	};
+
+	size_t count(uint64_t size) const
+	{
+		// An empty input still has one empty chunk
+		return size == 0 ? 1 : static_cast<size_t>((size + this->chunk_size - 1) / this->chunk_size);
+	}
+
+	md5::digest chunk(const file &f, uint64_t size, size_t index) const
+	{
+		std::vector<char> buffer(std::min<uint64_t>(this->chunk_size, 1 << 20));
+		uint64_t offset = static_cast<uint64_t>(index) * this->chunk_size;
+		const uint64_t end = std::min<uint64_t>(offset + this->chunk_size, size);
+
+		md5 h;
+		while(offset < end)
+		{
+			const ssize_t read = pread(f.fd, buffer.data(), std::min<uint64_t>(buffer.size(), end - offset), offset);
+			if(read < 0 && errno == EINTR)
+				continue;
+			if(read <= 0)
+				throw std::system_error(read < 0 ? errno : EIO, std::generic_category(), "Can't read chunk");
+			h.update(buffer.data(), read);
+			offset += read;
+		}
+		return h.finish();
+	}
+
+	md5::digest chunk(const char *data, uint64_t size, size_t index) const
+	{
+		const uint64_t offset = static_cast<uint64_t>(index) * this->chunk_size;
+		md5 h;
+		h.update(data + offset, std::min<uint64_t>(this->chunk_size, size - offset));
+		return h.finish();
+	}
+
+	// Hashes the listed chunks of source on the pool, chunks must be sized
+	template<typename tSource>
+	void run(const tSource &source, uint64_t size, const std::vector<size_t> &indexes, std::vector<md5::digest> &chunks) const
+	{
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::atomic<bool> failed(false);
+
+		auto worker = [&]()
+		{
+			try
+			{
+				for(size_t i = next++; i < indexes.size() && !failed; i = next++)
+					chunks[indexes[i]] = this->chunk(source, size, indexes[i]);
+			}
+			catch(...)
+			{
+				if(!failed.exchange(true))
+					error = std::current_exception();
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for(size_t i = 1; i < std::min<size_t>(this->threads, indexes.size()); i++)
+			pool.push_back(std::thread(worker));
+		worker();
+		for(std::thread &t : pool)
+			t.join();
+
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	template<typename tSource>
+	result hash_all(const tSource &source, uint64_t size) const
+	{
+		result ret;
+		ret.size = size;
+		ret.chunks.resize(this->count(size));
+
+		std::vector<size_t> indexes(ret.chunks.size());
+		for(size_t i = 0; i < indexes.size(); i++)
+			indexes[i] = i;
+
+		this->run(source, size, indexes, ret.chunks);
+		ret.root = combine(ret.chunks);
+		return ret;
+	}
+
+public:
+	md5_tree(size_t _chunk_size = 8 << 20, unsigned _threads = std::thread::hardware_concurrency())
+		: chunk_size(_chunk_size), threads(std::max(1u, _threads))
+	{
+		if(this->chunk_size == 0)
+			throw std::invalid_argument("Chunk size must be positive");
+	}
+
+	size_t get_chunk_size() const
+	{
+		return this->chunk_size;
+	}
+
+	static md5::digest combine(const std::vector<md5::digest> &chunks)
+	{
+		md5 h;
+		for(const md5::digest &d : chunks)
+			h.update(d);
+		return h.finish();
+	}
+
+	result hash(const std::string &path) const
+	{
+		file f(path);
+		return this->hash_all(f, f.size());
+	}
+
+	result hash(const void *data, size_t size) const
+	{
+		return this->hash_all(static_cast<const char*>(data), size);
+	}
+
+	// Digest of a single chunk, to verify a range against a previous result
+	md5::digest chunk(const std::string &path, size_t index) const
+	{
+		file f(path);
+		const uint64_t size = f.size();
+		if(index >= this->count(size))
+			throw std::out_of_range("Chunk index past the end of the file");
+		return this->chunk(f, size, index);
+	}
+
+	// Re-hashes the changed chunks of a previous result, and the chunks at
+	// its old and new end if the file was resized, then updates the root.
+	void rehash(const std::string &path, result &r, const std::vector<size_t> &changed) const
+	{
+		file f(path);
+		const uint64_t size = f.size();
+		const size_t before = r.chunks.size();
+
+		std::vector<size_t> indexes;
+		const size_t after = this->count(size);
+		for(size_t i : changed)
+		{
+			if(i < after)
+				indexes.push_back(i);
+		}
+
+		// The previous last chunk may have been partial, and the new last one
+		// is cut short when the file shrank
+		if(size != r.size)
+		{
+			if(before > 0 && before - 1 < after)
+				indexes.push_back(before - 1);
+			indexes.push_back(after - 1);
+		}
+		for(size_t i = before; i < after; i++)
+			indexes.push_back(i);
+
+		std::sort(indexes.begin(), indexes.end());
+		indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+		r.size = size;
+		r.chunks.resize(after);
+		this->run(f, size, indexes, r.chunks);
+		r.root = combine(r.chunks);
+	}
+};
+
+} // namespace hashs
+} // namespace network
+} // namespace boost
@@ -0,0 +1,31 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdlib>
+#include <new>
+
+#include "tst/allocations.hpp"
+
+void* operator new(size_t size)
+{
+	if(tst::allocations *counter = tst::allocations::current())
+	{
+		counter->count++;
+		counter->bytes += size;
+	}
+	if(void *ret = std::malloc(size ? size : 1))
+		return ret;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
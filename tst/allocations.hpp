@@ -0,0 +1,35 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+
+namespace tst
+{
+	// Counts what operator new hands out on the calling thread while alive.
+	// operator new is replaced in tst/allocations.cpp, and only counts inside a scope.
+	class allocations
+	{
+	private:
+		allocations *previous;
+
+	public:
+		size_t count = 0;
+		size_t bytes = 0;
+
+		allocations() : previous(current())	{ current() = this; }
+		~allocations()							{ current() = this->previous; }
+
+		allocations(const allocations&) = delete;
+		allocations& operator=(const allocations&) = delete;
+
+		static allocations*& current()
+		{
+			static thread_local allocations *ret = nullptr;
+			return ret;
+		}
+	};
+} // namespace tst
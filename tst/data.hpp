@@ -0,0 +1,25 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Input shared by the tests and benches
+namespace tst
+{
+	// Reproducible pseudo random bytes, a different seed gives different ones
+	inline std::string data(size_t size, uint32_t seed = 42)
+	{
+		std::string ret(size, '\0');
+		for(char &c : ret)
+		{
+			seed = seed * 1103515245 + 12345;
+			c = static_cast<char>(seed >> 24);
+		}
+		return ret;
+	}
+} // namespace tst
@@ -0,0 +1,127 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <gtest/gtest.h>
+
+#include "decompress.hpp"
+#include "json.hpp"
+#include "md5.hpp"
+#include "tst/data.hpp"
+
+static std::string gzip(const std::string &input)
+{
+	z_stream z;
+	std::memset(&z, 0, sizeof(z));
+	deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+	std::string ret(deflateBound(&z, input.size()), '\0');
+	z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+	z.avail_in = input.size();
+	z.next_out = reinterpret_cast<Bytef*>(&ret[0]);
+	z.avail_out = ret.size();
+	deflate(&z, Z_FINISH);
+	ret.resize(z.total_out);
+	deflateEnd(&z);
+	return ret;
+}
+
+static std::string read_all(std::istream &is)
+{
+	std::string ret;
+	char buffer[1000];
+	while(is.read(buffer, sizeof(buffer)) || is.gcount() > 0)
+		ret.append(buffer, is.gcount());
+	return ret;
+}
+
+TEST(decompress, gzip)
+{
+	const std::string input = tst::data(1 << 20);
+	std::istringstream compressed(gzip(input));
+
+	// Small blocks, to go around the ring many times
+	decompress::istream is(compressed, 4096, 3);
+	EXPECT_EQ(read_all(is), input);
+
+	// Concatenated members read as one stream
+	std::istringstream twice(gzip("hello ") + gzip("world"));
+	decompress::istream both(twice);
+	EXPECT_EQ(read_all(both), "hello world");
+
+	// Anything else passes through
+	std::istringstream plain("{\"a\": 1}");
+	decompress::istream same(plain);
+	EXPECT_EQ(read_all(same), "{\"a\": 1}");
+}
+
+TEST(decompress, zlib)
+{
+	const std::string input = tst::data(100000);
+	std::string packed(compressBound(input.size()), '\0');
+	uLongf size = packed.size();
+	compress(reinterpret_cast<Bytef*>(&packed[0]), &size, reinterpret_cast<const Bytef*>(input.data()), input.size());
+	packed.resize(size);
+
+	std::istringstream compressed(packed);
+	decompress::istream is(compressed, 4096);
+	EXPECT_EQ(read_all(is), input);
+
+	// Plain input starting like a zlib header: the check bits match, but the
+	// window size, preset dictionary flag or first block give it away
+	for(const std::string &text : {std::string("(4 apples)"), std::string("(Some text)\n"), std::string("\xE8\x04 bytes")})
+	{
+		ASSERT_EQ(((static_cast<unsigned char>(text[0]) << 8) | static_cast<unsigned char>(text[1])) % 31, 0) << text;
+		std::istringstream plain(text);
+		decompress::istream same(plain);
+		EXPECT_EQ(read_all(same), text);
+	}
+}
+
+TEST(decompress, consumers)
+{
+	std::stringstream json_text;
+	json_text << "[";
+	for(int i = 0; i < 10000; i++)
+		json_text << (i ? "," : "") << "{\"id\": " << i << ", \"name\": \"item " << i << "\"}";
+	json_text << "]";
+
+	std::istringstream compressed(gzip(json_text.str()));
+	decompress::istream is(compressed, 8192);
+	json::value v = json::parser(is).parse();
+	ASSERT_EQ(v.to_array().size(), 10000);
+	EXPECT_EQ(v.get(9999).get("id").to_integer(), 9999);
+
+	const std::string input = tst::data(300000);
+	std::istringstream plain(input), packed(gzip(input));
+	decompress::istream unpacked(packed, 8192);
+	EXPECT_TRUE(boost::network::hashs::md5(unpacked).hash() == boost::network::hashs::md5(plain).hash());
+}
+
+TEST(decompress, errors)
+{
+	const std::string compressed = gzip(tst::data(100000));
+
+	std::istringstream truncated(compressed.substr(0, compressed.size() / 2));
+	decompress::istream cut(truncated, 4096);
+	EXPECT_THROW(read_all(cut), decompress::decompress_error);
+
+	std::string garbled = compressed;
+	for(size_t i = 20; i < 60; i++)
+		garbled[i] = ~garbled[i];
+	std::istringstream corrupted(garbled);
+	decompress::istream bad(corrupted, 4096);
+	EXPECT_THROW(read_all(bad), decompress::decompress_error);
+
+	// Errors reach the parser, they don't look like the end of the document
+	std::istringstream half(gzip("[1, 2, 3, 4]").substr(0, 15));
+	decompress::istream json_cut(half);
+	EXPECT_THROW(json::parser(json_cut).parse(), decompress::decompress_error);
+
+	// Dropping a stream early stops its thread
+	std::istringstream unread(compressed);
+	decompress::istream dropped(unread, 1024, 2);
+	EXPECT_EQ(static_cast<char>(dropped.get()), tst::data(1)[0]);
+}
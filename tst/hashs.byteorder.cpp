@@ -0,0 +1,32 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include "byteorder.hpp"
+
+using namespace boost::network::hashs;
+
+TEST(hashs_byteorder, flip)
+{
+	EXPECT_EQ(byteorder::flip(static_cast<uint8_t>(0x12)), 0x12);
+	EXPECT_EQ(byteorder::flip(static_cast<uint16_t>(0x1234)), 0x3412);
+	EXPECT_EQ(byteorder::flip(static_cast<uint32_t>(0x12345678)), 0x78563412u);
+	EXPECT_EQ(byteorder::flip(static_cast<uint64_t>(0x0123456789ABCDEFull)), 0xEFCDAB8967452301ull);
+	EXPECT_EQ(byteorder::flip(byteorder::flip(static_cast<uint64_t>(0x8000000000000001ull))), 0x8000000000000001ull);
+}
+
+TEST(hashs_byteorder, layouts)
+{
+	const uint64_t v = 0x0123456789ABCDEFull;
+	const unsigned char big[8] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+	const unsigned char little[8] = {0xEF, 0xCD, 0xAB, 0x89, 0x67, 0x45, 0x23, 0x01};
+
+	const uint64_t b = byteorder::big(v), l = byteorder::little(v);
+	EXPECT_EQ(std::memcmp(&b, big, 8), 0);
+	EXPECT_EQ(std::memcmp(&l, little, 8), 0);
+}
@@ -97,3 +97,26 @@ TEST(hashs_md5, tst_sample_cpp)
 	EXPECT_TRUE(testf("tst/sample.json", {{0x2b2cf1f7, 0x2f00fea6, 0xdcad8585, 0xa9f8f4e5}}));
 }
 
+
+TEST(hashs_md5, incremental)
+{
+	const std::string s("12345678901234567890123456789012345678901234567890123456789012345678901234567890");
+	
+	for(size_t split = 0; split <= s.size(); split += 7)
+	{
+		md5 h;
+		h.update(s.data(), split);
+		h.update(s.data() + split, s.size() - split);
+		EXPECT_EQ(h.finish(), md5::digest({{0x57edf4a2, 0x2be3c955, 0xac49da2e, 0x2107b67a}})) << split;
+	}
+}
+
+TEST(hashs_md5, million_a)
+{
+	const std::string chunk(1000, 'a');
+	
+	md5 h;
+	for(int i = 0; i < 1000; i++)
+		h.update(chunk.data(), chunk.size());
+	EXPECT_EQ(h.finish(), md5::digest({{0x7707d6ae, 0x4e027c70, 0xeea2a935, 0xc2296f21}}));
+}
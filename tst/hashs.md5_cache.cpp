@@ -0,0 +1,138 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <fstream>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "md5_cache.hpp"
+
+using namespace boost::network::hashs;
+
+static std::string temp_dir()
+{
+	char path[] = "/tmp/md5_cache.XXXXXX";
+	if(mkdtemp(path) == nullptr)
+		throw std::system_error(errno, std::generic_category(), "Can't create temporary directory");
+	return path;
+}
+
+static void write(const std::string &path, const std::string &content)
+{
+	std::ofstream os(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	os << content;
+}
+
+TEST(hashs_md5_cache, hits)
+{
+	const std::string dir = temp_dir();
+	const std::string index = dir + "/index", file = dir + "/file";
+	write(file, "abc");
+	
+	{
+		md5_cache cache(index, 16);
+		EXPECT_EQ(cache.hash(file), md5::digest({{0x90015098, 0x3cd24fb0, 0xd6963f7d, 0x28e17f72}}));
+		EXPECT_EQ(cache.misses(), 1);
+		EXPECT_EQ(cache.hash(file), md5::digest({{0x90015098, 0x3cd24fb0, 0xd6963f7d, 0x28e17f72}}));
+		EXPECT_EQ(cache.hits(), 1);
+		
+		write(file, "message digest");
+		EXPECT_EQ(cache.hash(file), md5::digest({{0xf96b697d, 0x7cb7938d, 0x525a2f31, 0xaaf161d0}}));
+		EXPECT_EQ(cache.misses(), 2);
+	}
+	
+	// Reopened from disk
+	md5_cache cache(index);
+	EXPECT_EQ(cache.hash(file), md5::digest({{0xf96b697d, 0x7cb7938d, 0x525a2f31, 0xaaf161d0}}));
+	EXPECT_EQ(cache.hits(), 1);
+	EXPECT_EQ(cache.misses(), 0);
+	
+	unlink(file.c_str());
+	unlink(index.c_str());
+	rmdir(dir.c_str());
+}
+
+TEST(hashs_md5_cache, eviction)
+{
+	const std::string dir = temp_dir();
+	const std::string index = dir + "/index";
+	
+	// Many more files than entries, every digest must still be right
+	md5_cache cache(index, 4);
+	for(int round = 0; round < 2; round++)
+	{
+		for(int i = 0; i < 32; i++)
+		{
+			const std::string file = dir + "/" + std::to_string(i);
+			if(round == 0)
+				write(file, std::to_string(i));
+			
+			std::stringstream ss(std::to_string(i));
+			EXPECT_EQ(cache.hash(file), md5(ss).hash());
+		}
+	}
+	
+	for(int i = 0; i < 32; i++)
+		unlink((dir + "/" + std::to_string(i)).c_str());
+	unlink(index.c_str());
+	rmdir(dir.c_str());
+}
+
+TEST(hashs_md5_cache, concurrent_open)
+{
+	const std::string dir = temp_dir();
+	const std::string index = dir + "/index", file = dir + "/file";
+	write(file, "abc");
+
+	// Every opener races to create the index, none may resize it under another
+	std::vector<std::thread> threads;
+	for(int i = 0; i < 8; i++)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			md5_cache cache(index, 64);
+			for(int j = 0; j < 100; j++)
+				EXPECT_EQ(cache.hash(file), md5::digest({{0x90015098, 0x3cd24fb0, 0xd6963f7d, 0x28e17f72}}));
+		}));
+	}
+	for(std::thread &t : threads)
+		t.join();
+
+	unlink(file.c_str());
+	unlink(index.c_str());
+	rmdir(dir.c_str());
+}
+
+TEST(hashs_md5_cache, crashed_writer)
+{
+	const std::string dir = temp_dir();
+	const std::string index = dir + "/index", file = dir + "/file";
+	write(file, "abc");
+
+	{
+		md5_cache cache(index, 1);
+	}
+
+	// A single entry, left claimed as by a writer that died: the sequence
+	// counter follows the 16 bytes header
+	const int fd = open(index.c_str(), O_RDWR);
+	ASSERT_GE(fd, 0);
+	const uint64_t odd = 1;
+	ASSERT_EQ(pwrite(fd, &odd, sizeof(odd), 16), static_cast<ssize_t>(sizeof(odd)));
+	close(fd);
+
+	md5_cache cache(index);
+	EXPECT_EQ(cache.hash(file), md5::digest({{0x90015098, 0x3cd24fb0, 0xd6963f7d, 0x28e17f72}}));
+	EXPECT_EQ(cache.misses(), 1);
+	EXPECT_EQ(cache.hash(file), md5::digest({{0x90015098, 0x3cd24fb0, 0xd6963f7d, 0x28e17f72}}));
+	EXPECT_EQ(cache.hits(), 1);
+
+	unlink(file.c_str());
+	unlink(index.c_str());
+	rmdir(dir.c_str());
+}
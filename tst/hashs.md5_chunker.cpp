@@ -0,0 +1,94 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <set>
+#include <sstream>
+#include <gtest/gtest.h>
+
+#include "md5_chunker.hpp"
+#include "tst/data.hpp"
+
+using namespace boost::network::hashs;
+
+static std::vector<md5_chunker::chunk> chunks(const std::string &input, size_t min, size_t avg, size_t max)
+{
+	std::istringstream is(input);
+	md5_chunker chunker(is, min, avg, max);
+
+	std::vector<md5_chunker::chunk> ret;
+	md5_chunker::chunk c;
+	while(chunker.next(c))
+		ret.push_back(c);
+	return ret;
+}
+
+TEST(hashs_md5_chunker, chunks)
+{
+	const std::string input = tst::data(1 << 20);
+	const std::vector<md5_chunker::chunk> result = chunks(input, 1024, 4096, 16384);
+
+	uint64_t offset = 0;
+	for(size_t i = 0; i < result.size(); i++)
+	{
+		const md5_chunker::chunk &c = result[i];
+		EXPECT_EQ(c.offset, offset);
+		EXPECT_LE(c.size, 16384);
+		if(i + 1 < result.size())
+		{
+			EXPECT_GE(c.size, 1024);
+		}
+
+		md5 h;
+		h.update(input.data() + c.offset, c.size);
+		EXPECT_EQ(c.digest, h.finish());
+		offset += c.size;
+	}
+	EXPECT_EQ(offset, input.size());
+
+	// Normalized chunking keeps the mean close to the requested average
+	const size_t mean = input.size() / result.size();
+	EXPECT_GT(mean, 2048);
+	EXPECT_LT(mean, 8192);
+
+	EXPECT_TRUE(chunks("", 1024, 4096, 16384).empty());
+	EXPECT_EQ(chunks("abc", 1024, 4096, 16384).size(), 1);
+	EXPECT_THROW(chunks("abc", 4096, 1024, 16384), std::invalid_argument);
+}
+
+TEST(hashs_md5_chunker, insertion)
+{
+	const std::string input = tst::data(1 << 20);
+	std::string edited = input;
+	edited.insert(300000, "inserted bytes");
+
+	std::set<md5::digest> before;
+	for(const md5_chunker::chunk &c : chunks(input, 1024, 4096, 16384))
+		before.insert(c.digest);
+
+	// Boundaries resynchronize after the insertion, only a few chunks change
+	const std::vector<md5_chunker::chunk> after = chunks(edited, 1024, 4096, 16384);
+	size_t changed = 0;
+	for(const md5_chunker::chunk &c : after)
+		changed += before.count(c.digest) == 0;
+	EXPECT_LE(changed, 3);
+	EXPECT_GE(changed, 1);
+}
+
+TEST(hashs_md5_chunker, streaming)
+{
+	// Larger than the read buffer, chunks must not depend on where refills happen
+	const std::string input = tst::data(8 << 20, 7);
+	const std::vector<md5_chunker::chunk> all = chunks(input, 2048, 8192, 65536);
+
+	// Restarting from any boundary gives back the same chunks
+	const size_t first = all.size() / 3;
+	const std::vector<md5_chunker::chunk> tail = chunks(input.substr(all[first].offset), 2048, 8192, 65536);
+	ASSERT_EQ(tail.size(), all.size() - first);
+	for(size_t i = 0; i < tail.size(); i++)
+	{
+		EXPECT_EQ(tail[i].offset + all[first].offset, all[first + i].offset);
+		EXPECT_EQ(tail[i].digest, all[first + i].digest);
+	}
+}
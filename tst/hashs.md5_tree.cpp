@@ -0,0 +1,95 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <fstream>
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+#include "md5_tree.hpp"
+#include "tst/data.hpp"
+
+using namespace boost::network::hashs;
+
+static md5::digest plain(const std::string &s)
+{
+	md5 h;
+	h.update(s.data(), s.size());
+	return h.finish();
+}
+
+static std::string temp_file(const std::string &content)
+{
+	char path[] = "/tmp/md5_tree.XXXXXX";
+	close(mkstemp(path));
+	std::ofstream os(path, std::ios::out | std::ios::binary);
+	os << content;
+	return path;
+}
+
+TEST(hashs_md5_tree, memory)
+{
+	const std::string input = tst::data(10000);
+	md5_tree tree(1024, 4);
+	md5_tree::result r = tree.hash(input.data(), input.size());
+	
+	ASSERT_EQ(r.chunks.size(), 10);
+	std::vector<md5::digest> expect;
+	for(size_t i = 0; i < 10; i++)
+		expect.push_back(plain(input.substr(i * 1024, 1024)));
+	EXPECT_EQ(r.chunks, expect);
+	EXPECT_EQ(r.root, md5_tree::combine(expect));
+	
+	// An empty input has a single empty chunk
+	EXPECT_EQ(md5_tree(1 << 20).hash("", 0).chunks.front(), plain(""));
+
+	EXPECT_THROW(md5_tree(0), std::invalid_argument);
+}
+
+TEST(hashs_md5_tree, file)
+{
+	std::string input = tst::data(100000);
+	const std::string path = temp_file(input);
+	md5_tree tree(4096, 4);
+	
+	md5_tree::result r = tree.hash(path);
+	EXPECT_EQ(r.root, tree.hash(input.data(), input.size()).root);
+	EXPECT_EQ(tree.chunk(path, 3), r.chunks[3]);
+	
+	// Change one chunk and grow the file
+	input[5 * 4096 + 17] ^= 1;
+	input += tst::data(5000);
+	std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc) << input;
+	
+	tree.rehash(path, r, {5});
+	md5_tree::result expect = tree.hash(input.data(), input.size());
+	EXPECT_EQ(r.size, input.size());
+	EXPECT_EQ(r.chunks, expect.chunks);
+	EXPECT_EQ(r.root, expect.root);
+	
+	unlink(path.c_str());
+}
+
+TEST(hashs_md5_tree, truncate)
+{
+	std::string input = tst::data(100000);
+	const std::string path = temp_file(input);
+	md5_tree tree(4096, 4);
+	md5_tree::result r = tree.hash(path);
+
+	// Cut in the middle of a chunk, nothing reported as changed
+	for(size_t size : {50000, 40960, 100})
+	{
+		input.resize(size);
+		std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc) << input;
+
+		tree.rehash(path, r, {});
+		md5_tree::result expect = tree.hash(input.data(), input.size());
+		EXPECT_EQ(r.size, input.size());
+		EXPECT_EQ(r.chunks, expect.chunks);
+		EXPECT_EQ(r.root, expect.root);
+	}
+
+	unlink(path.c_str());
+}
@@ -0,0 +1,158 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "json.hpp"
+#include "json_parallel.hpp"
+#include "md5.hpp"
+
+#ifdef VITRINE_INSTRUMENT
+
+class recorder : public instrument::hook
+{
+public:
+	instrument::counters parse, hash;
+	
+	void parsed(const instrument::counters &c) { this->parse += c; }
+	void hashed(const instrument::counters &c) { this->hash += c; }
+};
+
+static size_t index(json::value::types t)
+{
+	return static_cast<size_t>(t);
+}
+
+TEST(instrument, parser)
+{
+	std::string json("{\"a\": [1, 2.5, \"x\\ty\", true, null, {\"b\": []}], \"long\": \"0123456789abcdefghijklmnopqrstuvwxyz\"}");
+	
+	recorder r;
+	instrument::set_hook(&r);
+	std::stringstream ss(json);
+	json::parser(ss).parse();
+	instrument::set_hook(nullptr);
+	
+	EXPECT_EQ(r.parse.parses, 1);
+	EXPECT_EQ(r.parse.parsed_bytes, json.size());
+	EXPECT_EQ(r.parse.values[index(json::value::types::OBJECT)], 2);
+	EXPECT_EQ(r.parse.values[index(json::value::types::ARRAY)], 2);
+	EXPECT_EQ(r.parse.values[index(json::value::types::INTEGER)], 1);
+	EXPECT_EQ(r.parse.values[index(json::value::types::REAL)], 1);
+	EXPECT_EQ(r.parse.values[index(json::value::types::STRING)], 2);
+	EXPECT_EQ(r.parse.values[index(json::value::types::BOOLEAN)], 1);
+	EXPECT_EQ(r.parse.values[index(json::value::types::NILL)], 1);
+	EXPECT_EQ(r.parse.strings_escaped, 1);
+	EXPECT_EQ(r.parse.max_depth, 4);
+	EXPECT_GT(r.parse.nanoseconds[instrument::PARSE], 0);
+	EXPECT_EQ(r.hash.hashes, 0);
+}
+
+TEST(instrument, allocations)
+{
+	const std::string longer(40, 'x');
+	std::string json("{\"short\": \"abc\", \"" + longer + "\": [\"" + longer + "\"]}");
+
+	recorder r;
+	instrument::set_hook(&r);
+	std::stringstream plain(json);
+	json::parser(plain).parse();
+
+	// Object, array and its buffer, 2 members, the long key's copy, the long
+	// string, and the parser's key buffer growing for the long key
+	EXPECT_EQ(r.parse.allocations, 8);
+
+	// Interned keys allocate once per table, short keys aren't interned, and
+	// a reused parser keeps its buffers
+	json::key_table keys;
+	json::parser p(keys);
+	for(int i = 0; i < 2; i++)
+	{
+		r.parse = instrument::counters();
+		std::stringstream ss(json);
+		p.reset(ss);
+		p.parse();
+		EXPECT_EQ(r.parse.allocations, i == 0 ? 8 : 6);
+	}
+
+	// Parsed into a tree of the same shape, nothing is allocated
+	json::value v;
+	for(int i = 0; i < 2; i++)
+	{
+		r.parse = instrument::counters();
+		std::stringstream ss(json);
+		p.reset(ss);
+		p.parse_into(v);
+	}
+	EXPECT_EQ(r.parse.allocations, 0);
+	instrument::set_hook(nullptr);
+}
+
+TEST(instrument, parallel)
+{
+	std::stringstream text;
+	text << "[";
+	for(int i = 0; i < 2000; i++)
+		text << (i ? ", " : "") << "{\"id\": " << i << ", \"name\": \"item number " << i << " \\t\", \"tags\": [1.5, true, null]}";
+	text << "]";
+	const std::string json = text.str();
+
+	recorder serial, parallel;
+	instrument::set_hook(&serial);
+	std::stringstream ss(json);
+	json::parser(ss).parse();
+	instrument::set_hook(&parallel);
+	json::parallel_parser(json.data(), json.size(), 4).parse();
+	instrument::set_hook(nullptr);
+
+	// One parse, whatever the number of slices
+	EXPECT_EQ(parallel.parse.parses, 1);
+	EXPECT_EQ(parallel.parse.parsed_bytes, serial.parse.parsed_bytes);
+	for(size_t i = 0; i < instrument::TYPES_COUNT; i++)
+		EXPECT_EQ(parallel.parse.values[i], serial.parse.values[i]) << i;
+	EXPECT_EQ(parallel.parse.strings_escaped, serial.parse.strings_escaped);
+	EXPECT_EQ(parallel.parse.max_depth, serial.parse.max_depth);
+}
+
+TEST(instrument, md5)
+{
+	recorder r;
+	instrument::set_hook(&r);
+	std::stringstream ss(std::string(1000, 'a'));
+	boost::network::hashs::md5(ss).hash();
+	instrument::set_hook(nullptr);
+	
+	EXPECT_EQ(r.hash.hashes, 1);
+	EXPECT_EQ(r.hash.hashed_bytes, 1000);
+	EXPECT_EQ(r.parse.parses, 0);
+}
+
+TEST(instrument, threads)
+{
+	const instrument::counters before = instrument::snapshot();
+	
+	std::vector<std::thread> threads;
+	for(int i = 0; i < 4; i++)
+	{
+		threads.push_back(std::thread([]()
+		{
+			for(int j = 0; j < 10; j++)
+			{
+				std::stringstream ss("[1, 2, 3]");
+				json::parser(ss).parse();
+			}
+		}));
+	}
+	for(std::thread &t : threads)
+		t.join();
+	
+	const instrument::counters after = instrument::snapshot();
+	EXPECT_EQ(after.parses - before.parses, 40);
+	EXPECT_EQ(after.values[index(json::value::types::INTEGER)] - before.values[index(json::value::types::INTEGER)], 120);
+}
+
+#endif
@@ -0,0 +1,83 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <gtest/gtest.h>
+#include "json_columns.hpp"
+
+TEST(json_columns, extract)
+{
+	std::stringstream ss("[{\"id\": 1, \"name\": \"a\", \"ok\": true, \"score\": 1, \"tags\": [1], \"nested\": {\"id\": 9}},"
+		"{\"name\": \"bc\", \"id\": 2, \"ok\": null, \"score\": 2.5},"
+		"{\"id\": 3, \"extra\": \"x\", \"score\": null}]");
+	json::columns cols = json::extract_columns(ss);
+
+	EXPECT_EQ(cols.rows, 3);
+	ASSERT_EQ(cols.fields.size(), 5);
+
+	const json::column &id = cols.get("id");
+	EXPECT_EQ(id.kind, json::column::kinds::INTEGER);
+	EXPECT_EQ(id.integers, std::vector<int64_t>({1, 2, 3}));
+	EXPECT_EQ(id.count_nulls(), 0);
+
+	const json::column &name = cols.get("name");
+	EXPECT_EQ(name.kind, json::column::kinds::STRING);
+	EXPECT_EQ(name.blob, "abc");
+	EXPECT_EQ(name.get_string(1), "bc");
+	EXPECT_TRUE(name.is_null(2));
+	EXPECT_EQ(name.get_string(2), "");
+
+	const json::column &ok = cols.get("ok");
+	EXPECT_EQ(ok.booleans, std::vector<uint8_t>({1, 0, 0}));
+	EXPECT_TRUE(ok.is_null(1));
+
+	// Promoted to reals when 2.5 shows up
+	const json::column &score = cols.get("score");
+	EXPECT_EQ(score.kind, json::column::kinds::REAL);
+	EXPECT_EQ(score.reals, std::vector<double>({1, 2.5, 0}));
+	EXPECT_TRUE(score.is_null(2));
+
+	// Appears late, the rows before are nulls
+	const json::column &extra = cols.get("extra");
+	EXPECT_EQ(extra.count_nulls(), 2);
+	EXPECT_EQ(extra.get_string(2), "x");
+	EXPECT_THROW(cols.get("tags"), std::out_of_range);
+}
+
+TEST(json_columns, projection)
+{
+	std::stringstream records;
+	records << "[";
+	for(int i = 0; i < 1000; i++)
+		records << (i ? "," : "") << "{\"id\": " << i << ", \"name\": \"n" << i << "\", \"score\": " << (i % 7 ? std::to_string(i) + ".5" : "null") << "}";
+	records << "]";
+
+	json::columns cols = json::extract_columns(records, {"score", "id", "missing"});
+	ASSERT_EQ(cols.fields.size(), 3);
+	EXPECT_EQ(cols.rows, 1000);
+	EXPECT_EQ(cols.get("id").sum_integers(), 999 * 1000 / 2);
+	EXPECT_EQ(cols.get("missing").count_nulls(), 1000);
+
+	double expect = 0;
+	for(int i = 0; i < 1000; i++)
+		expect += i % 7 ? i + 0.5 : 0;
+	EXPECT_EQ(cols.get("score").sum_reals(), expect);
+	EXPECT_EQ(cols.get("score").count_nulls(), 143);
+}
+
+TEST(json_columns, errors)
+{
+	std::stringstream mixed("[{\"a\": 1}, {\"a\": \"x\"}]");
+	EXPECT_THROW(json::extract_columns(mixed), json::columns_error);
+
+	std::stringstream scalar("[1]");
+	EXPECT_THROW(json::extract_columns(scalar), json::columns_error);
+
+	std::stringstream root("{\"a\": 1}");
+	EXPECT_THROW(json::extract_columns(root), json::columns_error);
+
+	std::stringstream nested("[{\"a\": {}}]");
+	EXPECT_THROW(json::extract_columns(nested, {"a"}), json::columns_error);
+}
@@ -0,0 +1,122 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <gtest/gtest.h>
+#include "json_document.hpp"
+#include "tst/allocations.hpp"
+
+TEST(json_document, reuse)
+{
+	json::document doc;
+	std::istringstream first("{\"a\": [1, 2, {\"b\": \"x\"}], \"c\": \"y\"}");
+	json::value &v = doc.parse(first);
+	EXPECT_EQ(v.get("a").get(2).get("b").to_string(), "x");
+
+	// Members and elements not in the new document are gone, types follow it
+	std::istringstream second("{\"a\": [\"s\"], \"d\": {}}");
+	doc.parse(second);
+	EXPECT_EQ(v.size(), 2);
+	EXPECT_EQ(v.get("a").size(), 1);
+	EXPECT_EQ(v.get("a").get(0).to_string(), "s");
+	EXPECT_TRUE(v.get("d").is_object());
+	EXPECT_THROW(v.get("c"), std::out_of_range);
+
+	std::istringstream expect("{\"a\": [\"s\"], \"d\": {}}");
+	EXPECT_EQ(v, json::parser(expect).parse());
+
+	// Duplicated keys keep the first value, like a fresh parse
+	std::istringstream dup("{\"a\": 1, \"a\": 2}");
+	EXPECT_EQ(doc.parse(dup).get("a").to_integer(), 1);
+
+	std::istringstream root("[1, 2]");
+	EXPECT_TRUE(doc.parse(root).is_array());
+}
+
+TEST(json_document, pool)
+{
+	json::document_pool &pool = json::document_pool::local();
+	json::document *first;
+	{
+		json::document_pool::handle h = pool.acquire();
+		first = &*h;
+		std::istringstream is("[1]");
+		h->parse(is);
+	}
+	EXPECT_EQ(pool.size(), 1);
+
+	json::document_pool::handle h = pool.acquire();
+	EXPECT_EQ(&*h, first);
+	EXPECT_EQ(h->get().type, json::value::types::NONE);
+	EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(json_document, key_limit)
+{
+	// Every document has keys of its own
+	json::document doc(100);
+	for(int i = 0; i < 1000; i++)
+	{
+		const std::string name = "a key too long to be inline " + std::to_string(i);
+		std::istringstream is("{\"" + name + "\": " + std::to_string(i) + "}");
+		EXPECT_EQ(doc.parse(is).get(name).to_integer(), i);
+		doc.reset();
+		EXPECT_LE(doc.key_count(), 100);
+	}
+}
+
+class membuf : public std::streambuf
+{
+public:
+	void set(const std::string &s)
+	{
+		char *p = const_cast<char*>(s.data());
+		this->setg(p, p, p + s.size());
+	}
+};
+
+static std::string request(int i)
+{
+	std::ostringstream ss;
+	ss << "{\"id\": " << i << ", \"name\": \"request number " << i << " with a long name\", \"score\": " << i << ".5,"
+		<< " \"tags\": [\"a\", \"b\", \"" << std::string(i % 3 + 20, 'c') << "\"], \"nested\": {\"ok\": true, \"none\": null}}";
+	return ss.str();
+}
+
+TEST(json_document, allocations)
+{
+	std::vector<std::string> requests;
+	for(int i = 0; i < 100; i++)
+		requests.push_back(request(i));
+
+	membuf buf;
+	std::istream stream(&buf);
+
+	// Warm up: the tree, the key table and the parser buffers grow to fit
+	for(int i = 0; i < 10; i++)
+	{
+		json::document_pool::handle doc = json::document_pool::local().acquire();
+		buf.set(requests[i]);
+		stream.clear();
+		doc->parse(stream);
+	}
+
+	// Everything the parse, the tree and the pool ask from the heap
+	size_t count;
+	long long sum = 0;
+	{
+		tst::allocations counted;
+		for(const std::string &r : requests)
+		{
+			json::document_pool::handle doc = json::document_pool::local().acquire();
+			buf.set(r);
+			stream.clear();
+			sum += doc->parse(stream).get("id").to_integer();
+		}
+		count = counted.count;
+	}
+	EXPECT_EQ(count, 0);
+	EXPECT_EQ(sum, 99 * 100 / 2);
+}
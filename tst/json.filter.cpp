@@ -0,0 +1,115 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include "json_filter.hpp"
+
+static const char *people = "[{\"id\": 1, \"name\": \"ann\", \"age\": 31, \"address\": {\"city\": \"Paris\", \"zip\": \"75001\"}, \"tags\": [\"a\", {\"b\": 1}]},"
+	"{\"id\": 2, \"name\": \"bob\", \"age\": 17.5, \"address\": {\"zip\": \"69001\"}},"
+	"{\"id\": 3, \"name\": \"cid\", \"active\": true, \"address\": null}]";
+
+static std::string run(const std::string &input, const std::function<void(json::filter&)> &setup, const std::string &records = "")
+{
+	std::ostringstream os;
+	{
+		json::writer w(os);
+		json::filter f(w, records);
+		setup(f);
+		std::istringstream is(input);
+		f.run(is);
+	}
+	return os.str();
+}
+
+TEST(json_filter, project)
+{
+	// Records are kept whole by default
+	EXPECT_EQ(run("[{\"a\": [1, {\"b\": null}], \"c\": \"x\\ny\"}, {}]", [](json::filter&) {}),
+		"[{\"a\":[1,{\"b\":null}],\"c\":\"x\\ny\"},{}]");
+
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("name").select("address.city").select("tags"); }),
+		"[{\"name\":\"ann\",\"address\":{\"city\":\"Paris\"},\"tags\":[\"a\",{\"b\":1}]},"
+		"{\"name\":\"bob\"},{\"name\":\"cid\"}]");
+
+	// Selecting an object keeps it whole, fields are output in document order
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("address").select("id"); }),
+		"[{\"id\":1,\"address\":{\"city\":\"Paris\",\"zip\":\"75001\"}},{\"id\":2,\"address\":{\"zip\":\"69001\"}},"
+		"{\"id\":3,\"address\":null}]");
+
+	EXPECT_EQ(run("[]", [](json::filter &f) { f.select("id"); }), "[]");
+}
+
+TEST(json_filter, predicates)
+{
+	typedef json::filter::comparison op;
+
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("age", op::GREATER_EQUAL, 18); }), "[{\"id\":1}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("age", op::LESS, 20.0); }), "[{\"id\":2}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("name", op::GREATER, "b"); }), "[{\"id\":2},{\"id\":3}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("active", op::EQUAL, true); }), "[{\"id\":3}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("address.city", op::EQUAL, "Paris"); }), "[{\"id\":1}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("address", op::EQUAL, json::value()); }), "[{\"id\":3}]");
+
+	// Predicates are all required, on fields seen before or after the selected ones
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("name").where("id", op::NOT_EQUAL, 2).where("address.zip", op::LESS, "80000"); }),
+		"[{\"name\":\"ann\"}]");
+
+	// Different types are unequal, missing fields fail
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("name", op::NOT_EQUAL, 1); }), "[{\"id\":1},{\"id\":2},{\"id\":3}]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("name", op::LESS, 1); }), "[]");
+	EXPECT_EQ(run(people, [](json::filter &f) { f.select("id").where("active", op::NOT_EQUAL, false); }), "[{\"id\":3}]");
+
+	std::ostringstream os;
+	json::writer w(os);
+	json::filter f(w);
+	f.where("age", op::GREATER, 0);
+	std::istringstream is(people);
+	f.run(is);
+	EXPECT_EQ(f.records(), 3);
+	EXPECT_EQ(f.kept(), 2);
+
+	EXPECT_THROW(f.where("age", op::EQUAL, json::array()), json::filter_error);
+}
+
+TEST(json_filter, records)
+{
+	const std::string doc = "{\"meta\": {\"items\": [1]}, \"data\": {\"count\": 2, \"items\": [{\"id\": 1}, {\"id\": 2, \"x\": true}]}}";
+	EXPECT_EQ(run(doc, [](json::filter &f) { f.select("id"); }, "data.items"), "[{\"id\":1},{\"id\":2}]");
+	EXPECT_EQ(run(doc, [](json::filter&) {}, "data.missing"), "[]");
+
+	EXPECT_THROW(run(doc, [](json::filter&) {}), json::filter_error);
+	EXPECT_THROW(run(doc, [](json::filter&) {}, "data.count"), json::filter_error);
+	EXPECT_THROW(run(doc, [](json::filter&) {}, "meta.items"), json::filter_error);
+	EXPECT_THROW(run("[{}, 1]", [](json::filter&) {}), json::filter_error);
+
+	// Same output as building the tree and filtering it
+	std::stringstream big;
+	big << "[";
+	for(int i = 0; i < 1000; i++)
+		big << (i ? "," : "") << "{\"id\":" << i << ",\"score\":" << i * 0.5 << ",\"tags\":[\"t" << i % 7 << "\"],\"skip\":{\"deep\":[1,2,3]}}";
+	big << "]";
+
+	const std::string filtered = run(big.str(), [](json::filter &f) {
+		f.select("id").select("tags").where("score", json::filter::comparison::GREATER, 400);
+	});
+
+	std::istringstream is(big.str());
+	json::value all = json::parser(is).parse();
+	std::ostringstream expected;
+	{
+		json::writer w(expected);
+		w.begin_array();
+		for(json::value &record : all.to_array())
+		{
+			json::value &score = record.get("score");
+			if((score.is_real() ? score.to_real() : score.to_integer()) > 400)
+				w.begin_object().key("id").value(record.get("id")).key("tags").value(record.get("tags")).end_object();
+		}
+		w.end_array();
+	}
+	EXPECT_EQ(filtered, expected.str());
+}
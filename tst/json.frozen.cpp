@@ -0,0 +1,125 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+#include "json_frozen.hpp"
+
+static json::value parse(const std::string &s)
+{
+	std::istringstream is(s);
+	return json::parser(is).parse();
+}
+
+TEST(json_frozen, access)
+{
+	json::value v = parse("{\"name\": \"vitrine\", \"version\": 3, \"ratio\": 0.5, \"on\": true, \"off\": null,"
+		"\"list\": [1, \"two\", {\"name\": \"nested\"}], \"empty\": {}, \"\": \"\"}");
+	const json::frozen f = json::freeze(v);
+	const json::frozen::view root = f.root();
+
+	EXPECT_TRUE(root.is_object());
+	EXPECT_EQ(root.size(), 8);
+	EXPECT_EQ(root.get("name").to_string(), "vitrine");
+	EXPECT_STREQ(root.get("name").c_str(), "vitrine");
+	EXPECT_EQ(root.get("version").to_integer(), 3);
+	EXPECT_EQ(root.get("ratio").to_real(), 0.5);
+	EXPECT_TRUE(root.get("on").to_bool());
+	EXPECT_TRUE(root.get("off").is_null());
+	EXPECT_EQ(root.get("list").get(1).to_string(), "two");
+	EXPECT_EQ(root.get("list").get(2).get("name").to_string(), "nested");
+	EXPECT_EQ(root.get("empty").size(), 0);
+	EXPECT_EQ(root.get("").length(), 0);
+	EXPECT_THROW(root.get("missing"), std::out_of_range);
+	EXPECT_THROW(root.get("list").get(3), std::out_of_range);
+
+	// Members in key order
+	EXPECT_EQ(root.key(0), "");
+	EXPECT_EQ(root.key(7), "version");
+	EXPECT_EQ(root.thaw(), v);
+
+	// Independent from the tree it was made from
+	v.get("name").edit_string() = "changed";
+	EXPECT_EQ(root.get("name").to_string(), "vitrine");
+}
+
+TEST(json_frozen, shared_keys)
+{
+	std::stringstream records;
+	records << "[";
+	for(int i = 0; i < 1000; i++)
+		records << (i ? "," : "") << "{\"identifier\": " << i << ", \"description\": null}";
+	records << "]";
+	const json::frozen f = json::freeze(json::parser(records).parse());
+
+	// Keys stored once: 1000 records of two members and two null nodes each
+	EXPECT_LT(f.size(), 1000 * (2 * 24 + 16) + 1024);
+	EXPECT_EQ(f.root().get(999).get("identifier").to_integer(), 999);
+}
+
+TEST(json_frozen, threads)
+{
+	const json::frozen f = json::freeze(parse("{\"a\": [1, 2, 3], \"b\": {\"c\": \"d\"}}"));
+
+	std::vector<std::thread> threads;
+	std::vector<long long> sums(4, 0);
+	for(size_t t = 0; t < sums.size(); t++)
+	{
+		threads.push_back(std::thread([&f, &sums, t]()
+		{
+			for(int i = 0; i < 10000; i++)
+			{
+				for(size_t j = 0; j < 3; j++)
+					sums[t] += f.root().get("a").get(j).to_integer();
+				sums[t] += f.root().get("b").get("c").length();
+			}
+		}));
+	}
+	for(std::thread &t : threads)
+		t.join();
+	for(long long s : sums)
+		EXPECT_EQ(s, 70000);
+}
+
+TEST(json_frozen, files)
+{
+	json::value v = parse("{\"config\": {\"threads\": 8, \"name\": \"prod\"}, \"hosts\": [\"a\", \"b\"]}");
+	const json::frozen f = json::freeze(v);
+
+	char path[] = "/tmp/json_frozen.XXXXXX";
+	close(mkstemp(path));
+	{
+		std::ofstream os(path, std::ios::out | std::ios::binary);
+		f.save(os);
+	}
+
+	json::frozen mapped = json::frozen::load(path);
+	EXPECT_EQ(mapped.root().get("config").get("threads").to_integer(), 8);
+	EXPECT_EQ(mapped.root().thaw(), v);
+
+	std::ifstream is(path, std::ios::in | std::ios::binary);
+	EXPECT_EQ(json::frozen::read(is).root().get("hosts").get(1).to_string(), "b");
+
+	// Not trusted blindly: truncated or garbled files are rejected
+	std::string bytes;
+	{
+		std::ostringstream os;
+		f.save(os);
+		bytes = os.str();
+	}
+	std::istringstream truncated(bytes.substr(0, bytes.size() - 8));
+	EXPECT_THROW(json::frozen::read(truncated), json::frozen_error);
+
+	std::string garbled = bytes;
+	garbled[24] ^= 0x40;	// key count
+	std::istringstream bad(garbled);
+	EXPECT_THROW(json::frozen::read(bad), json::frozen_error);
+
+	std::istringstream text("{\"not\": \"frozen\"}");
+	EXPECT_THROW(json::frozen::read(text), json::frozen_error);
+	unlink(path);
+}
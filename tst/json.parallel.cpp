@@ -0,0 +1,82 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <fstream>
+#include <gtest/gtest.h>
+#include "json_parallel.hpp"
+
+static std::string records(size_t count)
+{
+	std::stringstream ss;
+	ss << "[\n";
+	for(size_t i = 0; i < count; i++)
+	{
+		if(i)
+			ss << ",\n";
+		ss << "{\"id\": " << i << ", \"name\": \"rec\\\"" << i << "\", \"tags\": [\"a,b\", \"]\"], \"score\": " << i << ".5}";
+	}
+	ss << "\n]";
+	return ss.str();
+}
+
+static std::string print(const json::value &v)
+{
+	std::stringstream ss;
+	ss << v;
+	return ss.str();
+}
+
+TEST(json_parallel, same_as_serial)
+{
+	std::string json = records(5000);
+
+	std::stringstream serial(json), parallel(json);
+	json::value expect = json::parser(serial).parse();
+	json::value test = json::parallel_parser(parallel, 4).parse();
+	
+	EXPECT_EQ(test.size(), 5000);
+	EXPECT_EQ(print(test), print(expect));
+}
+
+TEST(json_parallel, object_root)
+{
+	std::stringstream ss;
+	ss << "{";
+	for(size_t i = 0; i < 5000; i++)
+		ss << "\"k" << i << "\": {\"v\": [" << i << "]},";
+	ss << "\"k0\": 0}";
+	std::string json = ss.str();
+
+	std::stringstream serial(json), parallel(json);
+	json::value expect = json::parser(serial).parse();
+	json::value test = json::parallel_parser(parallel, 4).parse();
+	
+	EXPECT_EQ(print(test), print(expect));
+	EXPECT_TRUE(test.get("k0").is_object());
+}
+
+TEST(json_parallel, sample)
+{
+	std::ifstream serial("tst/sample.json"), parallel("tst/sample.json");
+	json::value expect = json::parser(serial).parse();
+	json::value test = json::parallel_parser(parallel).parse();
+
+	EXPECT_EQ(print(test), print(expect));
+}
+
+TEST(json_parallel, error_position)
+{
+	std::string json = records(5000);
+	json.insert(json.rfind(",\n") + 2, "@");
+
+	std::stringstream serial(json), parallel(json);
+	std::tuple<int, int> expect, test;
+	try { json::parser(serial).parse(); } catch(json::parser::parsing_error &e) { expect = e.get_pos(); }
+	try { json::parallel_parser(parallel, 4).parse(); } catch(json::parser::parsing_error &e) { test = e.get_pos(); }
+
+	EXPECT_NE(std::get<0>(expect), 0);
+	EXPECT_EQ(test, expect);
+}
@@ -4,6 +4,7 @@
 //          http://www.boost.org/LICENSE_1_0.txt)
 
 #include <chrono>
+#include <clocale>
 #include <sstream>
 #include <fstream>
 #include <gtest/gtest.h>
@@ -52,3 +53,150 @@ TEST(json_parser, json_test_suite_sample)
 	sample >> test;
 }
 
+
+TEST(json_parser, interned_keys)
+{
+	std::string json("[{\"identifier_number\":1, \"display_name_text\":\"foo\", \"id\":1},"
+		" {\"identifier_number\":2, \"display_name_text\":\"bar\", \"id\":2}, {\"identifier_number\":3}]");
+
+	std::stringstream ss(json);
+	json::key_table keys;
+	json::value test = json::parser(ss, keys).parse();
+	
+	// Keys within std::string's own buffer aren't shared
+	EXPECT_EQ(keys.size(), 2);
+	
+	json::object &first = test.get(0).to_object();
+	json::object &second = test.get(1).to_object();
+	EXPECT_TRUE(first.find("identifier_number")->first.same(second.find("identifier_number")->first));
+	EXPECT_FALSE(first.find("id")->first.interned());
+	
+	json::key id = keys.intern("identifier_number");
+	EXPECT_EQ(test.get(2).get(id).to_integer(), 3);
+	EXPECT_EQ(test.get(1).get("display_name_text").to_string(), "bar");
+	EXPECT_EQ(test.get(1).get("id").to_integer(), 2);
+
+	// A plain key is no bigger than its string and a flag
+	EXPECT_LE(sizeof(json::key), sizeof(std::string) + sizeof(void*));
+}
+
+TEST(json_parser, unicode_surrogates)
+{
+	std::string json("{\"pair\":\"\\ud83d\\ude00 \\u00e9\", \"raw\":\"caf\xc3\xa9 \xf0\x9f\x98\x80\"}");
+
+	std::stringstream ss(json);
+	json::value test;
+	ss >> test;
+	
+	EXPECT_EQ(test.get("pair").to_string(), "\xf0\x9f\x98\x80 \xc3\xa9");
+	EXPECT_EQ(test.get("raw").to_string(), "caf\xc3\xa9 \xf0\x9f\x98\x80");
+}
+
+TEST(json_parser, invalid_unicode)
+{
+	const char *invalids[] = {
+		"[\"\\ud83d\"]",			// lone high surrogate
+		"[\"\\ude00\"]",			// lone low surrogate
+		"[\"\\ud83d\\u0041\"]",		// high surrogate followed by a non surrogate
+		"[\"\\u12G4\"]",			// bad hex digit
+		"[\"\xc3\"]",				// truncated sequence
+		"[\"\xc0\xaf\"]",			// overlong
+		"[\"\xed\xa0\x80\"]",		// encoded surrogate
+		"[\"\xf4\x90\x80\x80\"]",	// past U+10FFFF
+	};
+	
+	for(const char *json : invalids)
+	{
+		std::stringstream ss(json);
+		json::value test;
+		EXPECT_THROW(ss >> test, json::parser::parsing_error) << json;
+	}
+}
+
+TEST(json_parser, string_whitespace)
+{
+	std::string json("[\"  foo \\t bar  \"]");
+
+	std::stringstream ss(json);
+	json::value test;
+	ss >> test;
+	
+	EXPECT_EQ(test.get(0).to_string(), "  foo \t bar  ");
+}
+
+static json::value parse_text(const std::string &str)
+{
+	std::stringstream ss(str);
+	return json::parser(ss).parse();
+}
+
+TEST(json_parser, numbers)
+{
+	json::value v = parse_text("[-12, 0.5, 1e-400, 1e-5000, 9223372036854775807]");
+	EXPECT_EQ(v.get(0).to_integer(), -12);
+	EXPECT_EQ(v.get(1).to_real(), 0.5);
+	EXPECT_GT(v.get(2).to_real(), 0);
+	EXPECT_EQ(v.get(3).to_real(), 0);
+	EXPECT_EQ(v.get(4).to_integer(), 9223372036854775807LL);
+
+	// Only overflows are errors
+	EXPECT_THROW(parse_text("[1e5000]"), json::parser::parsing_error);
+	EXPECT_THROW(parse_text("[-1e5000]"), json::parser::parsing_error);
+	EXPECT_THROW(parse_text("[9223372036854775808]"), json::parser::parsing_error);
+	EXPECT_THROW(parse_text("[1.5.2]"), json::parser::parsing_error);
+}
+
+TEST(json_parser, duplicate_keys)
+{
+	// The first wins, later ones with duplicates of their own are skipped
+	json::value v = parse_text("{\"a\":1,\"a\":{\"b\":1,\"b\":\"str\",\"c\":2}}");
+	EXPECT_EQ(v, parse_text("{\"a\":1}"));
+
+	v = parse_text("{\"a\":{\"b\":1,\"b\":[{\"c\":1,\"c\":2}]},\"a\":{\"b\":{\"b\":1,\"b\":2}}}");
+	EXPECT_EQ(v, parse_text("{\"a\":{\"b\":1}}"));
+}
+
+TEST(json_parser, locale)
+{
+	// A decimal comma locale must not change how numbers are read
+	const char *previous = std::setlocale(LC_NUMERIC, nullptr);
+	const std::string saved = previous ? previous : "C";
+	bool found = false;
+	for(const char *name : {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"})
+		found = found || std::setlocale(LC_NUMERIC, name) != nullptr;
+	if(!found)
+		GTEST_SKIP() << "No locale with a decimal comma installed";
+
+	json::value v = parse_text("[1.5, 2e3]");
+	std::setlocale(LC_NUMERIC, saved.c_str());
+	EXPECT_EQ(v.get(0).to_real(), 1.5);
+	EXPECT_EQ(v.get(1).to_real(), 2000);
+}
+
+class recorder
+{
+public:
+	std::string events;
+
+	void begin_object()					{ this->events += "{"; }
+	void key(const std::string &k)		{ this->events += k + ":"; }
+	void end_object()					{ this->events += "}"; }
+	void begin_array()					{ this->events += "["; }
+	void end_array()					{ this->events += "]"; }
+	void null()							{ this->events += "n "; }
+	void boolean(bool v)				{ this->events += v ? "t " : "f "; }
+	void integer(long long v)			{ this->events += "i" + std::to_string(v) + " "; }
+	void real(long double v)			{ this->events += "r" + std::to_string(static_cast<double>(v)) + " "; }
+	void string(const std::string &v)	{ this->events += "s" + v + " "; }
+};
+
+TEST(json_parser, events)
+{
+	std::stringstream ss("{\"a\": [1, 2.5, \"x\", true, false, null], \"b\": {}}");
+	recorder r;
+	json::parser(ss).parse(r);
+	EXPECT_EQ(r.events, "{a:[i1 r2.500000 sx t f n ]b:{}}");
+
+	std::stringstream bad("{\"a\": [1, }");
+	EXPECT_THROW(json::parser(bad).parse(r), json::parser::parsing_error);
+}
@@ -0,0 +1,154 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <fstream>
+#include <gtest/gtest.h>
+#include "json_patch.hpp"
+
+static json::value parse(const std::string &str)
+{
+	std::stringstream ss(str);
+	json::value ret;
+	ss >> ret;
+	return ret;
+}
+
+static void roundtrip(const std::string &from, const std::string &to, size_t expected_ops)
+{
+	json::value a = parse(from), b = parse(to);
+	json::value ops = json::diff(a, b);
+	EXPECT_EQ(ops.size(), expected_ops) << ops;
+
+	json::patch(a, ops);
+	EXPECT_EQ(a, b) << a;
+}
+
+TEST(json_patch, diff_equal)
+{
+	roundtrip("{\"a\":[1,2,{\"b\":null}]}", "{\"a\":[1,2,{\"b\":null}]}", 0);
+}
+
+TEST(json_patch, diff_object)
+{
+	roundtrip("{\"a\":1, \"b\":{\"c\":\"d\", \"e\":[1]}, \"f/g\":true}",
+		"{\"b\":{\"c\":\"x\", \"e\":[1]}, \"f/g\":true, \"h\":0.5}", 3);
+}
+
+TEST(json_patch, diff_array)
+{
+	roundtrip("[1,2,3,4,5,6]", "[0,1,2,4,5,7,6]", 3);
+	roundtrip("[1,2,3]", "[]", 3);
+	roundtrip("[]", "[1,2,3]", 3);
+	roundtrip("[{\"a\":1,\"b\":2},{\"a\":3}]", "[{\"a\":1,\"b\":3},{\"a\":3}]", 1);
+}
+
+TEST(json_patch, diff_types)
+{
+	roundtrip("{\"a\":1}", "{\"a\":1.0}", 1);
+	roundtrip("{\"a\":[]}", "{\"a\":{}}", 1);
+	roundtrip("[1]", "{\"a\":1}", 1);
+}
+
+TEST(json_patch, diff_canonical_numbers)
+{
+	// 1 and 1.0 hash alike, the patch still keeps the types
+	roundtrip("[1, 2.0, 3]", "[1.0, 2, 3]", 2);
+	roundtrip("{\"a\":[1]}", "{\"a\":[1.0]}", 1);
+}
+
+TEST(json_patch, diff_sample)
+{
+	std::ifstream sample("tst/sample.json");
+	json::value a;
+	sample >> a;
+
+	json::value b = a;
+	b.to_object().erase(b.to_object().begin());
+	b.add("added", "value");
+	
+	json::value ops = json::diff(a, b);
+	EXPECT_EQ(ops.size(), 2);
+	json::patch(a, ops);
+	EXPECT_EQ(a, b);
+}
+
+TEST(json_patch, diff_versions)
+{
+	json::value v1 = json::object();
+	v1.add("items", json::array());
+	for(int i = 0; i < 1000; i++)
+	{
+		json::value item = json::object();
+		item.add("id", i);
+		item.add("tags", json::array());
+		v1.get("items").add(item);
+	}
+
+	json::hash_cache cache(true);
+	EXPECT_EQ(json::diff(v1, v1, cache).size(), 0);
+	const size_t cached = cache.size();
+
+	// Each version is a copy of the last with one change: only the containers
+	// on the way down to it are hashed again
+	json::value v2 = v1;
+	v2.get("items").get(500).get("tags").add("new");
+	json::value ops = json::diff(v1, v2, cache);
+	ASSERT_EQ(ops.size(), 1) << ops;
+	EXPECT_EQ(ops.get(0).get("path"), json::value("/items/500/tags/0"));
+	EXPECT_EQ(cache.size(), cached + 4);
+
+	// Containers handed out for writing but left unchanged yield nothing
+	json::value v3 = v2;
+	v3.get("items").get(10).get("id");
+	v3.get("items").get(20).to_object().erase("tags");
+	ops = json::diff(v2, v3, cache);
+	EXPECT_EQ(ops.size(), 1) << ops;
+	EXPECT_EQ(cache.size(), cached + 8);
+
+	// A real turned integer does, the cache is exact
+	v3.get("items").get(10).get("id") = 10.0;
+	ops = json::diff(v2, v3, cache);
+	EXPECT_EQ(ops.size(), 2) << ops;
+	json::patch(v2, ops);
+	EXPECT_EQ(v2, v3);
+
+	json::hash_cache canonical;
+	EXPECT_THROW(json::diff(v1, v2, canonical), std::invalid_argument);
+}
+
+TEST(json_patch, apply)
+{
+	json::value doc = parse("{\"foo\":[\"bar\",\"baz\"], \"a~b\":{\"c\":1}}");
+	json::patch(doc, parse("["
+		"{\"op\":\"add\", \"path\":\"/foo/1\", \"value\":\"qux\"},"
+		"{\"op\":\"add\", \"path\":\"/foo/-\", \"value\":\"end\"},"
+		"{\"op\":\"test\", \"path\":\"/a~0b/c\", \"value\":1},"
+		"{\"op\":\"test\", \"path\":\"/a~0b\", \"value\":{\"c\":1.0}},"
+		"{\"op\":\"copy\", \"from\":\"/a~0b\", \"path\":\"/copy\"},"
+		"{\"op\":\"move\", \"from\":\"/foo/0\", \"path\":\"/moved\"},"
+		"{\"op\":\"replace\", \"path\":\"/copy/c\", \"value\":2},"
+		"{\"op\":\"remove\", \"path\":\"/a~0b\"}"
+		"]"));
+
+	EXPECT_EQ(doc, parse("{\"foo\":[\"qux\",\"baz\",\"end\"], \"copy\":{\"c\":2}, \"moved\":\"bar\"}")) << doc;
+}
+
+TEST(json_patch, apply_errors)
+{
+	json::value doc = parse("{\"foo\":[1]}");
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"remove\", \"path\":\"/bar\"}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"add\", \"path\":\"/foo/2\", \"value\":1}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"replace\", \"path\":\"/foo/01\", \"value\":1}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"test\", \"path\":\"/foo/0\", \"value\":2}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"test\", \"path\":\"/foo/0\", \"value\":1.5}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"test\", \"path\":\"/foo\", \"value\":[1, 2]}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"test\", \"path\":\"/foo/0\", \"value\":\"1\"}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"move\", \"from\":\"/foo\", \"path\":\"/foo/0\"}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"nope\", \"path\":\"\"}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"replace\", \"path\":\"/foo/99999999999999999999\", \"value\":1}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"replace\", \"path\":\"/foo/1a\", \"value\":1}]")), json::patch_error);
+	EXPECT_THROW(json::patch(doc, parse("[{\"op\":\"add\", \"path\":\"/foo/-1\", \"value\":1}]")), json::patch_error);
+}
@@ -0,0 +1,93 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <gtest/gtest.h>
+#include "json_schema.hpp"
+
+static json::value parse(const std::string &s)
+{
+	std::istringstream is(s);
+	return json::parser(is).parse();
+}
+
+static const char *user_schema =
+	"{\"type\": \"object\", \"required\": [\"id\", \"name\"], \"properties\": {"
+	"\"id\": {\"type\": \"integer\", \"minimum\": 1},"
+	"\"name\": {\"type\": \"string\", \"maxLength\": 8, \"pattern\": \"^[^A-Z]+$\"},"
+	"\"score\": {\"type\": \"number\", \"maximum\": 10},"
+	"\"role\": {\"enum\": [\"admin\", \"user\", null, 3]},"
+	"\"tags\": {\"type\": \"array\", \"items\": {\"type\": \"string\"}},"
+	"\"address\": {\"type\": \"object\", \"required\": [\"city\"]}}}";
+
+static std::string violation(const json::schema &s, const std::string &doc)
+{
+	std::istringstream is(doc);
+	try
+	{
+		s.validate(is);
+	}
+	catch(json::validation_error &e)
+	{
+		return e.get_path() + " " + e.what();
+	}
+	return "";
+}
+
+TEST(json_schema, valid)
+{
+	json::schema s(parse(user_schema));
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"ab\"}"), "");
+	EXPECT_EQ(violation(s, "{\"id\": 2.0, \"name\": \"caf\\u00e9\", \"score\": 9.5, \"role\": null, \"tags\": [], \"extra\": {\"x\": [1]}}"), "");
+	EXPECT_EQ(violation(s, "{\"id\": 3, \"name\": \"abcdefgh\", \"role\": 3.0, \"address\": {\"city\": \"x\"}}"), "");
+
+	// Reusable across documents
+	json::schema::validator v(s);
+	for(int i = 1; i < 4; i++)
+	{
+		std::istringstream is("{\"id\": " + std::to_string(i) + ", \"name\": \"a\", \"tags\": [\"t\"]}");
+		json::parser(is).parse(v);
+	}
+
+	// Even after a document that failed inside an array
+	std::istringstream failed("{\"id\": 1, \"name\": \"a\", \"tags\": [2");
+	EXPECT_THROW(json::parser(failed).parse(v), json::validation_error);
+	std::istringstream next("{\"id\": 1, \"name\": \"a\"}");
+	EXPECT_NO_THROW(json::parser(next).parse(v));
+}
+
+TEST(json_schema, violations)
+{
+	json::schema s(parse(user_schema));
+	EXPECT_EQ(violation(s, "{\"name\": \"ab\"}"), " Missing required member id at \"\"");
+	EXPECT_EQ(violation(s, "{\"id\": 0, \"name\": \"ab\"}"), "/id Value below minimum at \"/id\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1.5, \"name\": \"ab\"}"), "/id Unexpected type at \"/id\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"abcdefghi\"}"), "/name String longer than maxLength at \"/name\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"AB\"}"), "/name String doesn't match pattern at \"/name\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"a\", \"score\": 11}"), "/score Value above maximum at \"/score\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"a\", \"role\": \"root\"}"), "/role Value not in enum at \"/role\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"a\", \"tags\": [\"a\", 2]}"), "/tags/1 Unexpected type at \"/tags/1\"");
+	EXPECT_EQ(violation(s, "{\"id\": 1, \"name\": \"a\", \"address\": {\"zip\": 1}}"), "/address Missing required member city at \"/address\"");
+	EXPECT_EQ(violation(s, "[1]"), " Unexpected type at \"\"");
+}
+
+TEST(json_schema, first_violation)
+{
+	// The parse stops at the first violation, the rest isn't even valid JSON
+	json::schema s(parse("{\"type\": \"array\", \"items\": {\"type\": \"integer\"}}"));
+	EXPECT_EQ(violation(s, "[1, 2, \"x\", @@@"), "/2 Unexpected type at \"/2\"");
+}
+
+TEST(json_schema, invalid_schemas)
+{
+	EXPECT_THROW(json::schema(parse("{\"type\": \"float\"}")), json::schema_error);
+	EXPECT_THROW(json::schema(parse("{\"pattern\": \"(\"}")), json::schema_error);
+	EXPECT_THROW(json::schema(parse("{\"pattern\": \"^caf\\u00e9$\"}")), json::schema_error);
+	EXPECT_THROW(json::schema(parse("{\"anyOf\": []}")), json::schema_error);
+	EXPECT_THROW(json::schema(parse("{\"enum\": [[1]]}")), json::schema_error);
+	EXPECT_THROW(json::schema(parse("{\"maxLength\": -1}")), json::schema_error);
+	EXPECT_NO_THROW(json::schema(parse("{\"maxLength\": 0}")));
+	EXPECT_NO_THROW(json::schema(parse("{\"title\": \"t\", \"description\": \"d\"}")));
+}
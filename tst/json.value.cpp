@@ -3,8 +3,10 @@
 //    (See accompanying file LICENSE_1_0.txt or copy at
 //          http://www.boost.org/LICENSE_1_0.txt)
 
+#include <fstream>
 #include <gtest/gtest.h>
 #include "json.hpp"
+#include "tst/allocations.hpp"
 
 TEST(json_value, nulls)
 {
@@ -98,3 +100,227 @@ TEST(json_value, objects)
 	EXPECT_TRUE(obj.get("true").to_bool());
 }
 
+
+TEST(json_value, hashes)
+{
+	json::value a = json::object();
+	a.add("int", 1);
+	a.add("arr", json::array());
+	a.get("arr").add("foo");
+	
+	json::value b = json::object();
+	b.add("arr", json::array());
+	b.get("arr").add("foo");
+	b.add("int", 1.0);
+	
+	EXPECT_EQ(a.hash(), b.hash());
+	EXPECT_NE(a.hash(), json::value(json::object()).hash());
+	EXPECT_NE(json::value("1").hash(), json::value(1).hash());
+	EXPECT_NE(json::value(1.5).hash(), json::value(1).hash());
+
+	// Reals hash by their bits: equal values alike, close ones apart
+	EXPECT_EQ(json::value(1.5).hash(), json::value(1.5L).hash());
+	EXPECT_NE(json::value(0.1).hash(), json::value(0.1L).hash());
+	EXPECT_NE(json::value(0.5).hash(), json::value(-0.5).hash());
+	EXPECT_NE(json::value(0.5).hash(), json::value(0.25).hash());
+	
+	json::value::digest before = a.hash();
+	a.get("arr").get(0).edit_string() = "bar";
+	EXPECT_NE(a.hash(), before);
+	a.get("arr").get(0).edit_string() = "foo";
+	EXPECT_EQ(a.hash(), before);
+	
+	json::value copy = a;
+	EXPECT_EQ(copy.hash(), before);
+	copy.get("arr").add(true);
+	EXPECT_NE(copy.hash(), before);
+	EXPECT_EQ(a.hash(), before);
+
+	// Children changed through references kept across hashes, or the variant
+	json::value &child = a.get("arr").get(0);
+	child.edit_string() = "changed";
+	EXPECT_NE(a.hash(), before);
+	boost::get<std::string>(child.variant) = "foo";
+	EXPECT_EQ(a.hash(), before);
+}
+
+TEST(json_value, hash_cache)
+{
+	json::value doc = json::object();
+	doc.add("list", json::array());
+	for(int i = 0; i < 10; i++)
+	{
+		json::value item = json::object();
+		item.add("id", i);
+		doc.get("list").add(item);
+	}
+
+	json::hash_cache cache;
+	const json::value::digest before = cache.hash(doc);
+	EXPECT_EQ(before, doc.hash());
+	EXPECT_EQ(cache.size(), 12);
+
+	// Changes made going down from the root are seen
+	doc.get("list").get(3).get("id").to_integer() = 42;
+	EXPECT_EQ(cache.hash(doc), doc.hash());
+	EXPECT_NE(cache.hash(doc), before);
+	doc.get("list").get(3).get("id").to_integer() = 3;
+	EXPECT_EQ(cache.hash(doc), before);
+
+	// A copy with one change reuses the digests of the rest
+	json::value copy = doc;
+	copy.get("list").get(5).get("id").to_integer() = 50;
+	const size_t cached = cache.size();
+	EXPECT_EQ(cache.hash(copy), copy.hash());
+	EXPECT_EQ(cache.size(), cached + 3);
+	EXPECT_EQ(cache.hash(doc), before);
+
+	// Exact digests tell 1.0 from 1
+	json::hash_cache exact(true);
+	EXPECT_EQ(cache.hash(json::value(1.0)), cache.hash(json::value(1)));
+	EXPECT_NE(exact.hash(json::value(1.0)), exact.hash(json::value(1)));
+	EXPECT_EQ(exact.hash(json::value(1.5)), cache.hash(json::value(1.5)));
+
+	// Members erased and added again at the same address aren't mistaken
+	// for the ones before
+	for(int i = 0; i < 10; i++)
+	{
+		json::object &list = doc.to_object();
+		list.erase("list");
+		json::value other = json::array();
+		other.add(i);
+		list.insert(std::make_pair(json::key("list"), other));
+		EXPECT_EQ(cache.hash(doc), doc.hash());
+	}
+
+	// References kept across a hash need the containers above invalidated
+	doc.get("list").add(json::object());
+	json::value &item = doc.get("list").get(1);
+	item.add("id", 1);
+	const json::value::digest kept = cache.hash(doc);
+	item.get("id").to_integer() = 2;
+	EXPECT_EQ(cache.hash(doc), kept);
+	cache.invalidate(doc.get("list"));
+	cache.invalidate(doc);
+	EXPECT_EQ(cache.hash(doc), doc.hash());
+
+	// The stamp fits in the padding before the variant
+	EXPECT_EQ(sizeof(json::value), 16 + sizeof(json::__variant));
+}
+
+TEST(json_value, memory)
+{
+	const std::string long_string(100, 'x');
+
+	json::value arr = json::array();
+	arr.to_array().reserve(8);
+	arr.add(1);
+	arr.add("short");
+	arr.add(long_string);
+
+	json::value::footprint f = arr.memory_usage();
+	EXPECT_EQ(f.containers, sizeof(json::array));
+	EXPECT_EQ(f.nodes, 8 * sizeof(json::value));
+	EXPECT_EQ(f.strings, long_string.capacity() + 1);
+	EXPECT_EQ(f.keys, 0);
+	EXPECT_EQ(f.slack, 5 * sizeof(json::value) + long_string.capacity() - long_string.size());
+
+	arr.shrink_to_fit();
+	f = arr.memory_usage();
+	EXPECT_EQ(f.nodes, 3 * sizeof(json::value));
+	EXPECT_EQ(f.slack, 0);
+	EXPECT_EQ(arr.get(2).to_string(), long_string);
+
+	// Short strings shrunk to no heap buffer at all
+	json::value str = std::string("tiny");
+	str.edit_string().reserve(1000);
+	EXPECT_GT(str.memory_usage().strings, 1000);
+	str.shrink_to_fit();
+	EXPECT_EQ(str.memory_usage().strings, 0);
+	EXPECT_EQ(str.to_string(), "tiny");
+
+	// Plain keys live in their member, interned keys are counted once
+	const std::string name = "a name too long to be inline";
+	json::value separate = json::array();
+	for(int i = 0; i < 3; i++)
+	{
+		json::value record = json::object();
+		record.add(name, i);
+		separate.add(record);
+	}
+	EXPECT_EQ(separate.memory_usage().keys, 3 * (name.size() + 1));
+
+	json::key_table table;
+	separate.shrink_to_fit(table);
+	EXPECT_EQ(table.size(), 1);
+	EXPECT_EQ(separate.memory_usage().keys, 2 * sizeof(void*) + sizeof(std::string) + name.size() + 1);
+	EXPECT_EQ(separate.get(2).get(name).to_integer(), 2);
+
+	json::value short_keys = json::object();
+	short_keys.add("id", 1);
+	EXPECT_EQ(short_keys.memory_usage().keys, 0);
+
+	// Equal long string values share one buffer, short ones stay as they are
+	json::value repeated = json::array();
+	for(int i = 0; i < 3; i++)
+	{
+		repeated.add(long_string);
+		repeated.add("short");
+	}
+	repeated.shrink_to_fit();
+	EXPECT_EQ(repeated.memory_usage().strings, 3 * (long_string.size() + 1));
+
+	json::string_table strings;
+	repeated.shrink_to_fit(table, strings);
+	EXPECT_EQ(strings.size(), 1);
+	EXPECT_EQ(repeated.memory_usage().strings, 2 * sizeof(void*) + sizeof(std::string) + long_string.size() + 1);
+	EXPECT_TRUE(repeated.get(0).shared_string());
+	EXPECT_FALSE(repeated.get(1).shared_string());
+	EXPECT_EQ(repeated.get(4).to_string(), long_string);
+	EXPECT_EQ(repeated, json::value(json::array({long_string, "short", long_string, "short", long_string, "short"})));
+
+	// Reads through non-const values keep the sharing
+	const size_t shared_bytes = repeated.memory_usage().strings;
+	for(size_t i = 0; i < repeated.size(); i++)
+		EXPECT_FALSE(repeated.get(i).to_string().empty());
+	EXPECT_TRUE(repeated.get(0).shared_string());
+	EXPECT_EQ(repeated.memory_usage().strings, shared_bytes);
+
+	// Writing to a shared string gives that value its own copy
+	repeated.get(2).edit_string() += "y";
+	EXPECT_FALSE(repeated.get(2).shared_string());
+	EXPECT_EQ(repeated.get(0).to_string(), long_string);
+	EXPECT_EQ(repeated.get(2).to_string(), long_string + "y");
+}
+
+TEST(json_value, memory_copy)
+{
+	json::value sample;
+	std::ifstream file("tst/sample.json");
+	file >> sample;
+	sample.add("a name too long to be inline", std::string(100, 'x'));
+
+	// A deep copy allocates exactly what memory_usage() reports for it
+	size_t bytes;
+	{
+		tst::allocations counted;
+		json::value copy = sample;
+		bytes = counted.bytes;
+		EXPECT_EQ(bytes, copy.memory_usage().total());
+	}
+	// The original less its unused capacity
+	const json::value::footprint parsed = sample.memory_usage();
+	EXPECT_EQ(parsed.total() - parsed.slack, bytes);
+
+	// Shared keys and strings are only referenced by the copy
+	json::key_table keys;
+	json::string_table strings;
+	sample.shrink_to_fit(keys, strings);
+	const json::value::footprint f = sample.memory_usage();
+	{
+		tst::allocations counted;
+		json::value copy = sample;
+		EXPECT_EQ(counted.bytes, f.nodes + f.containers);
+		EXPECT_EQ(copy, sample);
+	}
+}
@@ -0,0 +1,135 @@
+//          Copyright Lepesme "Jiboo" Jean-Baptiste 2012
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sstream>
+#include <clocale>
+#include <gtest/gtest.h>
+#include "json_writer.hpp"
+
+TEST(json_writer, document)
+{
+	std::ostringstream os;
+	{
+		json::writer w(os);
+		w.begin_object();
+		w.key("name").value("vitrine");
+		w.key("count").value(3);
+		w.key("size").value(static_cast<size_t>(42));
+		w.key("ratio").value(0.5);
+		w.key("tags").begin_array().value(true).null().value(-7).begin_object().end_object().end_array();
+		w.key("empty").begin_array().end_array();
+		w.end_object();
+	}
+	EXPECT_EQ(os.str(), "{\"name\":\"vitrine\",\"count\":3,\"size\":42,\"ratio\":0.5,"
+		"\"tags\":[true,null,-7,{}],\"empty\":[]}");
+
+	std::istringstream is(os.str());
+	json::value v = json::parser(is).parse();
+	EXPECT_EQ(v.get("count").to_integer(), 3);
+	EXPECT_EQ(v.get("tags").size(), 4);
+}
+
+TEST(json_writer, escaping)
+{
+	std::ostringstream os;
+	{
+		json::writer w(os);
+		w.begin_array().value("a\"b\\c/d\n\x01\xc3\xa9").end_array();
+	}
+	EXPECT_EQ(os.str(), "[\"a\\\"b\\\\c\\/d\\n\\u0001\xc3\xa9\"]");
+
+	// Same escaping and numbers as operator<<
+	json::value v = json::array();
+	v.add("a\"b\\c/d\n\x01\xc3\xa9");
+	v.add(0.1);
+	v.add(1e300);
+	v.add(2.0);
+	std::ostringstream printed, written;
+	printed << v;
+	json::writer(written).value(v);
+	EXPECT_EQ(printed.str(), "[\"a\\\"b\\\\c\\/d\\n\\u0001\xc3\xa9\", 0.1, 1.0e+300, 2.0]");
+	EXPECT_EQ(written.str(), "[\"a\\\"b\\\\c\\/d\\n\\u0001\xc3\xa9\",0.1,1.0e+300,2.0]");
+
+	// Enough digits to get the same doubles back
+	std::istringstream is(written.str());
+	json::value back = json::parser(is).parse();
+	EXPECT_EQ(back.get(0).to_string(), v.get(0).to_string());
+	EXPECT_EQ(static_cast<double>(back.get(1).to_real()), 0.1);
+	EXPECT_EQ(static_cast<double>(back.get(2).to_real()), 1e300);
+	EXPECT_TRUE(back.get(3).is_real());
+}
+
+TEST(json_writer, reals)
+{
+	// Shortest text that reads back the same double
+	const std::pair<double, const char*> cases[] = {
+		{0.1, "0.1"}, {0.3, "0.3"}, {0.1 + 0.2, "0.30000000000000004"}, {1.0 / 3, "0.3333333333333333"},
+		{2.0 / 3, "0.6666666666666666"}, {-1.5, "-1.5"}, {100.0, "100.0"}, {1e22, "1.0e+22"},
+		{5e-324, "5.0e-324"}, {1.7976931348623157e308, "1.7976931348623157e+308"}, {1e-300, "1.0e-300"},
+		{0.0, "0.0"}, {123456.0, "123456.0"}, {1e-5, "1.0e-05"}, {0.001, "0.001"},
+	};
+	for(const auto &c : cases)
+	{
+		std::ostringstream os;
+		json::writer(os).value(c.first);
+		EXPECT_EQ(os.str(), c.second);
+
+		std::istringstream is("[" + os.str() + "]");
+		EXPECT_EQ(static_cast<double>(json::parser(is).parse().get(0).to_real()), c.first) << c.second;
+	}
+
+	// Parsed reals are long doubles, they read back the same long double
+	const long double parsed[] = {0.1L, 1.0L / 3, 2.0L / 3, 1e-4000L, -1.18973149535723176502e+4932L};
+	for(long double r : parsed)
+	{
+		std::ostringstream os;
+		json::writer(os).value(r);
+		std::istringstream is("[" + os.str() + "]");
+		EXPECT_EQ(json::parser(is).parse().get(0).to_real(), r) << os.str();
+	}
+
+	std::ostringstream os;
+	json::writer(os).begin_array().value(0.1L).value(1e16L).end_array();
+	EXPECT_EQ(os.str(), "[0.1,1.0e+16]");
+}
+
+TEST(json_writer, locale)
+{
+	// Not in the locale's format, a decimal comma isn't JSON
+	const char *previous = std::setlocale(LC_NUMERIC, nullptr);
+	const std::string saved = previous ? previous : "C";
+	bool found = false;
+	for(const char *name : {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"})
+		found = found || std::setlocale(LC_NUMERIC, name) != nullptr;
+	if(!found)
+		GTEST_SKIP() << "No locale with a decimal comma installed";
+
+	std::ostringstream os;
+	json::writer(os).value(1.5);
+	std::setlocale(LC_NUMERIC, saved.c_str());
+	EXPECT_EQ(os.str(), "1.5");
+}
+
+TEST(json_writer, chunks)
+{
+	// Far larger than the buffer, written as it fills
+	std::ostringstream os;
+	json::writer w(os, 256);
+	w.begin_array();
+	for(int i = 0; i < 10000; i++)
+	{
+		w.value(i);
+		EXPECT_LE(w.buffered(), 256);
+	}
+	w.value(std::string(1000, 'x'));
+	w.end_array();
+	w.flush();
+
+	std::istringstream is(os.str());
+	json::value v = json::parser(is).parse();
+	ASSERT_EQ(v.size(), 10001);
+	EXPECT_EQ(v.get(9999).to_integer(), 9999);
+	EXPECT_EQ(v.get(10000).to_string().size(), 1000);
+}